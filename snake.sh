@@ -18,6 +18,12 @@ if [[ ! -x "$BIN" || "$SRC" -nt "$BIN" ]]; then
   "$CXX" -std=c++17 "$SRC" -O2 -pthread -o "$BIN"
 fi
 
+# (re)bake the asset pack when the binary or any asset is newer than it
+PACK="assets.pack"
+if [[ -d assets && ( ! -f "$PACK" || "$BIN" -nt "$PACK" || -n "$(find assets -newer "$PACK" -print -quit)" ) ]]; then
+  "./$BIN" --build-pack || echo "warning: asset pack not rebuilt" >&2
+fi
+
 echo "Running ./$BIN"
-"./$BIN"
+"./$BIN" "$@"
 
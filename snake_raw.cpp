@@ -3,15 +3,17 @@
 // + Floating text: when a poop activates, a random taunt rises up (only one at a time).
 
 #include <algorithm>
+#include <array>
+#include <bitset>
 #include <atomic>
 #include <chrono>
 #include <cctype>
+#include <cerrno>
 #include <cmath>
-#include <deque>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
-#include <mutex>
-#include <optional>
-#include <queue>
+#include <new>
 #include <random>
 #include <string>
 #include <thread>
@@ -21,178 +23,259 @@
 #include <cstdlib>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <cstdio>
 #include <ctime>
 #include <signal.h>
 #include <sys/wait.h>
+#include <poll.h>
+#include <spawn.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#endif
+
+extern char** environ; // for posix_spawnp; not every <unistd.h> declares it
 
 using namespace std;
 
 // ---------- Sound config ----------
 static constexpr bool ENABLE_SOUNDS = true;
-static constexpr bool ENABLE_BEEP_FALLBACK = false;
-
-static const char* BITE_SOUNDS[] = { "Pop", "Bottle", "Funk", "Tink", "Ping" };
-static constexpr const char* FART_SOUND    = "Submarine";
-static constexpr const char* SPLASH_SOUND  = "Purr";
-static constexpr const char* REWARD_SOUND  = "Glass";
-static constexpr const char* LEVEL_SOUND   = "Hero";
-static constexpr const char* BOMB_SOUND    = "Basso";
-static constexpr const char* DISARM_SOUND  = "Ping";
-
-// 🟤 Custom local WAVs inside assets/
-static constexpr const char* POOP_WAV   = "assets/snake_shit.wav"; // on poop activation (tail vacates)
-static constexpr const char* NOM_WAV    = "assets/nom_nom_nom.wav"; // poop-eating (final pellet)
-static constexpr const char* NASTY_WAV  = "assets/nasty.wav";       // poop-eating (final pellet)
-static constexpr const char* GROSS_WAV  = "assets/gross.wav";       // poop-eating (final pellet)
-static constexpr const char* TITLE_MUSIC_WAV = "assets/groove.wav"; // splash/title theme
-static constexpr const char* BG_MUSIC_WAV    = "assets/banzai.wav"; // quiet gameplay loop
-static constexpr const char* BG_MUSIC_VOL    = "0.19";              // 0.0..1.0 volume for afplay
-
-// Play macOS built-in system sound by name
-static inline void play_system_sound(const char* name) {
-    if (!ENABLE_SOUNDS || name == nullptr) return;
-    std::string cmd = "afplay '/System/Library/Sounds/" + std::string(name) + ".aiff' >/dev/null 2>&1 &";
-    (void)std::system(cmd.c_str());
-    if (ENABLE_BEEP_FALLBACK) { std::cout << '\a' << std::flush; }
-}
-
-// Play any local wav/aif file via afplay
-static inline void play_wav(const char* path) {
-    if (!ENABLE_SOUNDS || path == nullptr) return;
-    std::string cmd = "afplay '" + std::string(path) + "' >/dev/null 2>&1 &";
-    (void)std::system(cmd.c_str());
-}
-
-// ----- One-sound-per-frame queue (prevents echo/overlap) -----
-enum class SndType { None, Wav, Sys };
 
-struct PendingSound {
-    SndType type{SndType::None};
-    const char* wav{nullptr};
-    const char* sys{nullptr};
+// Every sound the game can play, by typed handle: clips shipped under the asset root,
+// then macOS system sounds (/System/Library/Sounds/<name>.aiff).
+enum class Sfx : uint8_t {
+    Poop, Nom, Nasty, Gross,
+    Pop, Bottle, Funk, Tink, Ping, Submarine, Purr, Glass, Hero, Basso,
+    Count
 };
-static PendingSound g_pending;
-
-static inline void queue_wav(const char* path) {
-    if (!ENABLE_SOUNDS || !path) return;
-    g_pending.type = SndType::Wav;
-    g_pending.wav  = path;
-    g_pending.sys  = nullptr;
-}
-static inline void queue_sys(const char* name) {
-    if (!ENABLE_SOUNDS || !name) return;
-    g_pending.type = SndType::Sys;
-    g_pending.sys  = name;
-    g_pending.wav  = nullptr;
-}
-static inline void flush_sound() {
-    if (!ENABLE_SOUNDS) { g_pending = {}; return; }
-    if (g_pending.type == SndType::Wav && g_pending.wav) {
-        play_wav(g_pending.wav);
-    } else if (g_pending.type == SndType::Sys && g_pending.sys) {
-        play_system_sound(g_pending.sys);
-    }
-    g_pending = {};
-}
 
-// ----- Title & Background music lifecycle (own processes we can stop cleanly) -----
-static pid_t g_title_music_pid = -1;
+static constexpr Sfx BITE_SOUNDS[] = { Sfx::Pop, Sfx::Bottle, Sfx::Funk, Sfx::Tink, Sfx::Ping };
+static constexpr Sfx FART_SOUND    = Sfx::Submarine;
+static constexpr Sfx SPLASH_SOUND  = Sfx::Purr;
+static constexpr Sfx REWARD_SOUND  = Sfx::Glass;
+static constexpr Sfx LEVEL_SOUND   = Sfx::Hero;
+static constexpr Sfx BOMB_SOUND    = Sfx::Basso;
+static constexpr Sfx DISARM_SOUND  = Sfx::Ping;
 
-// For background music we track both the shell PID and its process group ID.
-// We create a process group so we can kill the group (shell + any afplay children).
-static pid_t g_bg_music_pid  = -1;
-static pid_t g_bg_music_pgid = -1;
+static constexpr int   AUDIO_RATE    = 48000; // mixer/output sample rate (also baked into the asset pack)
+static constexpr float BG_MUSIC_VOL  = 0.19f; // 0.0..1.0
+static constexpr int   MUSIC_FADE_MS = 1500;  // title → background crossfade
 
 static bool file_exists(const char* p) {
     struct stat st{}; return ::stat(p, &st) == 0 && S_ISREG(st.st_mode);
 }
 
-static void stop_pid(pid_t& pid_ref) {
-    if (pid_ref > 0) {
-        kill(pid_ref, SIGTERM);
-        for (int i = 0; i < 50; ++i) { // up to ~500ms
-            if (waitpid(pid_ref, nullptr, WNOHANG) > 0) { pid_ref = -1; return; }
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
-        kill(pid_ref, SIGKILL);
-        waitpid(pid_ref, nullptr, 0);
-        pid_ref = -1;
+// ---------- Assets ----------
+// Every file the game loads, by typed handle. resolve_assets() picks the root and
+// checks each file once at startup; after that nothing asks the filesystem again.
+enum class Asset : uint8_t { PoopWav, NomWav, NastyWav, GrossWav, TitleMusic, BgMusic, Splash, Count };
+
+static constexpr const char* ASSET_FILES[] = {
+    "snake_shit.wav",  // 🟤 on poop activation (tail vacates)
+    "nom_nom_nom.wav", // poop-eating (final pellet)
+    "nasty.wav",       // poop-eating (final pellet)
+    "gross.wav",       // poop-eating (final pellet)
+    "groove.wav",      // splash/title theme
+    "banzai.wav",      // quiet gameplay loop
+    "splash.png",      // title image
+};
+static_assert(sizeof(ASSET_FILES) / sizeof(ASSET_FILES[0]) == (size_t)Asset::Count, "one file per Asset");
+
+// Pack file (<root>.pack, written by --build-pack): a header, an entry table, then
+// 64-byte-aligned blobs. Sound clips are stored already decoded to the mixer's PCM,
+// music as the original WAV bytes (streamed in place), and the splash as the base64
+// payload of its inline-image escape, so startup maps one file and does no decoding.
+// Each entry records its source file's size and mtime; a pack that no longer matches
+// the files under the root is ignored.
+// Skipped records a file the builder couldn't use (no bytes), so it still counts as seen.
+enum class PackForm : uint8_t { Raw, Pcm, Base64, Skipped };
+
+struct PackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint32_t audio_rate;
+    uint32_t reserved;
+};
+struct PackEntry {
+    uint8_t asset;
+    uint8_t form;
+    uint8_t pad[6];
+    uint64_t offset;
+    uint64_t size;
+    uint64_t src_size;  // source file when the pack was built
+    int64_t  src_mtime;
+};
+static_assert(sizeof(PackHeader) == 24 && sizeof(PackEntry) == 40, "pack layout is fixed on disk");
+static constexpr char PACK_MAGIC[8] = { 'S', 'N', 'A', 'K', 'P', 'A', 'C', 'K' };
+static constexpr uint32_t PACK_VERSION = 3;
+
+// Read-only private mapping of a whole file (MAP_FAILED if missing or empty).
+static void* map_file(const char* path, size_t& len) {
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return MAP_FAILED;
+    struct stat st{};
+    void* m = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        len = (size_t)st.st_size;
+        m = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
     }
+    ::close(fd);
+    return m;
 }
 
-static void stop_pgroup(pid_t& pgid_ref, pid_t& wait_pid_ref) {
-    if (pgid_ref > 0) {
-        // Send to the whole process group (negative PID targets pgrp)
-        kill(-pgid_ref, SIGTERM);
-        for (int i = 0; i < 50; ++i) {
-            if (waitpid(wait_pid_ref, nullptr, WNOHANG) > 0) {
-                wait_pid_ref = -1; pgid_ref = -1; return;
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
-        kill(-pgid_ref, SIGKILL);
-        (void)waitpid(wait_pid_ref, nullptr, 0);
-        wait_pid_ref = -1; pgid_ref = -1;
+struct AssetRegistry {
+    std::string root;
+    std::array<std::string, (size_t)Asset::Count> paths;
+    std::array<bool, (size_t)Asset::Count> present{};
+
+    // Pack mapping, if <root>.pack was found and matches this build
+    const unsigned char* pack{nullptr};
+    size_t pack_len{0};
+    std::array<const PackEntry*, (size_t)Asset::Count> packed{};
+
+    bool has(Asset a) const { return present[(size_t)a]; }
+    const char* path(Asset a) const { return paths[(size_t)a].c_str(); }
+
+    // The packed bytes of `a`, if the pack carries it in `form`.
+    bool blob(Asset a, PackForm form, const unsigned char*& p, size_t& n) const {
+        const PackEntry* e = packed[(size_t)a];
+        if (!e || e->form != (uint8_t)form) return false;
+        p = pack + e->offset;
+        n = (size_t)e->size;
+        return true;
     }
-}
 
-static void start_title_music() {
-    if (!ENABLE_SOUNDS) return;
-    if (!TITLE_MUSIC_WAV || !std::strlen(TITLE_MUSIC_WAV)) return;
-    if (!file_exists(TITLE_MUSIC_WAV)) return;
-    if (g_title_music_pid > 0) return; // already running
-
-    pid_t pid = fork();
-    if (pid == 0) {
-        execlp("afplay", "afplay", TITLE_MUSIC_WAV, (char*)nullptr);
-        _exit(127); // exec failed
-    } else if (pid > 0) {
-        g_title_music_pid = pid;
+    bool open_pack(const std::string& file) {
+        size_t len = 0;
+        void* m = map_file(file.c_str(), len);
+        if (m == MAP_FAILED) return false;
+        const unsigned char* d = (const unsigned char*)m;
+        PackHeader h;
+        bool ok = len >= sizeof h;
+        if (ok) {
+            std::memcpy(&h, d, sizeof h);
+            ok = std::memcmp(h.magic, PACK_MAGIC, 8) == 0 && h.version == PACK_VERSION &&
+                 h.audio_rate == (uint32_t)AUDIO_RATE && sizeof h + (size_t)h.count * sizeof(PackEntry) <= len;
+        }
+        const PackEntry* table = (const PackEntry*)(d + sizeof h);
+        for (uint32_t i = 0; ok && i < h.count; ++i) {
+            const PackEntry& e = table[i];
+            ok = e.asset < (uint8_t)Asset::Count && e.offset % 64 == 0 && e.offset <= len && e.size <= len - e.offset;
+            if (ok) packed[e.asset] = &e;
+        }
+        if (!ok) {
+            munmap(m, len);
+            packed = {};
+            return false;
+        }
+        pack = d;
+        pack_len = len;
+        return true;
+    }
+    void close_pack() {
+        if (pack) munmap((void*)pack, pack_len);
+        pack = nullptr;
+        pack_len = 0;
+        packed = {};
     }
+};
+static AssetRegistry g_assets;
+
+// A present asset is a non-empty regular file; .wav files must also carry a RIFF/WAVE header.
+static bool asset_valid(const std::string& path) {
+    struct stat st{};
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) return false;
+    if (path.size() < 4 || path.compare(path.size() - 4, 4, ".wav") != 0) return true;
+    char hdr[12] = {};
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    size_t n = std::fread(hdr, 1, sizeof hdr, f);
+    std::fclose(f);
+    return n == sizeof hdr && std::memcmp(hdr, "RIFF", 4) == 0 && std::memcmp(hdr + 8, "WAVE", 4) == 0;
 }
 
-static void stop_title_music() {
-    stop_pid(g_title_music_pid);
+static bool dir_exists(const std::string& p) {
+    struct stat st{}; return ::stat(p.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
 }
 
-static void start_bg_music() {
-    if (!ENABLE_SOUNDS) return;
-    if (!BG_MUSIC_WAV || !std::strlen(BG_MUSIC_WAV)) return;
-    if (!file_exists(BG_MUSIC_WAV)) return;
-    if (g_bg_music_pid > 0) return; // already running
-
-    // Spawn /bin/sh running an infinite loop of afplay at low volume.
-    // Put the child into its own process group so we can kill the group later.
-    pid_t pid = fork();
-    if (pid == 0) {
-        // Child: create a new process group with PGID = child's PID
-        setpgid(0, 0);
-        std::string script = std::string("while :; do afplay -q 1 -v ") + BG_MUSIC_VOL + " '" + BG_MUSIC_WAV + "'; done";
-        execlp("sh", "sh", "-c", script.c_str(), (char*)nullptr);
-        _exit(127);
-    } else if (pid > 0) {
-        // Parent: ensure the child is its own pgrp (in case of race)
-        setpgid(pid, pid);
-        g_bg_music_pid  = pid;
-        g_bg_music_pgid = pid;
+// Root: --assets DIR if given; else ./assets (running from the source tree); else the
+// assets/ directory next to the executable, so the binary works from any cwd.
+// Every packed entry must match its file's size and mtime, and nothing may have
+// turned up under the root that the pack lacks.
+static bool pack_is_fresh(const AssetRegistry& r) {
+    for (size_t i = 0; i < (size_t)Asset::Count; ++i) {
+        const PackEntry* e = r.packed[i];
+        struct stat st{};
+        if (!e) {
+            if (asset_valid(r.paths[i])) return false;
+            continue;
+        }
+        if (::stat(r.paths[i].c_str(), &st) != 0 || (uint64_t)st.st_size != e->src_size ||
+            (int64_t)st.st_mtime != e->src_mtime)
+            return false;
     }
+    return true;
 }
 
-static void stop_bg_music() {
-    stop_pgroup(g_bg_music_pgid, g_bg_music_pid);
+static void resolve_assets(const char* argv0, const char* root_override) {
+    AssetRegistry& r = g_assets;
+    if (root_override) {
+        r.root = root_override;
+    } else if (dir_exists("assets")) {
+        r.root = "assets";
+    } else {
+        char exe[4096] = {};
+#ifdef __linux__
+        ssize_t n = ::readlink("/proc/self/exe", exe, sizeof exe - 1);
+        if (n > 0) exe[n] = 0;
+        else
+#endif
+        if (!argv0 || !::realpath(argv0, exe)) exe[0] = 0;
+        std::string dir = exe;
+        size_t slash = dir.rfind('/');
+        r.root = slash == std::string::npos ? "assets" : dir.substr(0, slash) + "/assets";
+    }
+    for (size_t i = 0; i < (size_t)Asset::Count; ++i) r.paths[i] = r.root + "/" + ASSET_FILES[i];
+
+    // With a pack, presence comes from its table and the asset files are only stat'd.
+    const char* pack_state = "no";
+    if (r.open_pack(r.root + ".pack")) {
+        pack_state = "yes";
+        if (!pack_is_fresh(r)) {
+            r.close_pack();
+            pack_state = "stale";
+        }
+    }
+    int found = 0;
+    for (size_t i = 0; i < (size_t)Asset::Count; ++i) {
+        r.present[i] = r.pack ? r.packed[i] && r.packed[i]->form != (uint8_t)PackForm::Skipped : asset_valid(r.paths[i]);
+        found += r.present[i];
+    }
+    std::cerr << "[assets] root=" << r.root << " pack=" << pack_state
+              << " found=" << found << "/" << (int)Asset::Count << "\n";
 }
 
 // ---------- ANSI colors ----------
 static constexpr const char* RESET = "\x1b[0m";
-static constexpr const char* BG_BLUE = "\x1b[44m";
-static constexpr const char* FG_WHITE = "\x1b[37m";
-static constexpr const char* FG_BRIGHT_YELLOW = "\x1b[93m";
-static constexpr const char* FG_BRIGHT_GREEN  = "\x1b[92m";
-static constexpr const char* FG_BROWN_256     = "\x1b[38;5;130m";
-static constexpr const char* FG_RED           = "\x1b[91m";
-static constexpr const char* FG_ORANGE_208    = "\x1b[38;5;208m";
-static constexpr const char* FG_YELLOW        = "\x1b[33m";
+
+// Colors are xterm palette indices + 1, so 0 means "terminal default".
+static constexpr uint16_t pal(int n) { return (uint16_t)(n + 1); }
+static constexpr uint16_t C_DEFAULT       = 0;
+static constexpr uint16_t C_GREEN         = pal(2);
+static constexpr uint16_t C_YELLOW        = pal(3);
+static constexpr uint16_t C_BLUE          = pal(4);
+static constexpr uint16_t C_WHITE         = pal(7);
+static constexpr uint16_t C_BRIGHT_RED    = pal(9);
+static constexpr uint16_t C_BRIGHT_GREEN  = pal(10);
+static constexpr uint16_t C_BRIGHT_YELLOW = pal(11);
+static constexpr uint16_t C_BROWN         = pal(130);
+static constexpr uint16_t C_ORANGE        = pal(208);
+
+static constexpr uint8_t A_BOLD    = 1;
+static constexpr uint8_t A_REVERSE = 2;
 
 // ---------- Config ----------
 static constexpr int ROWS = 20;
@@ -203,11 +286,23 @@ static constexpr int MIN_TICK_MS  = 40;  // fastest cap
 static constexpr int TICK_DECR_MS = 10;  // level-up speed gain
 static constexpr int GROW_DECR_MS = 3;   // per-unit speed gain (food / idle / penalty growth)
 
+// Loop pacing: ticks run on their own fixed timestep; frames are only drawn when
+// something changed, and at most once per FRAME_MS.
+static constexpr int FRAME_MS          = 16;  // presentation cap (~60 Hz)
+static constexpr int MAX_CATCHUP_TICKS = 3;   // late ticks replayed per wakeup; the rest are skipped
+static constexpr int STALL_MS          = 250; // further behind than this → pause instead of catching up
+
 // Poop/Bomb timings & penalty
 static constexpr auto GOOD_WINDOW = std::chrono::seconds(15);
 static constexpr auto BOMB_WINDOW = std::chrono::seconds(15);
 static constexpr int  BOMB_GROW_UNITS = 2;
 
+// Extra invariant checks (occupancy bitmap etc.); build with -DSNAKE_DEBUG=1
+#ifndef SNAKE_DEBUG
+#define SNAKE_DEBUG 0
+#endif
+static constexpr bool DEBUG_CHECKS = SNAKE_DEBUG != 0;
+
 // Wide-head glyph during chomp (double-width in most terminals)
 static const std::string WIDE_HEAD = "🟢";
 
@@ -243,58 +338,734 @@ struct RawTerm {
 };
 
 // ---------- Input queue ----------
-mutex in_mtx;
-queue<char> in_q;
+// Fixed-capacity single-producer/single-consumer lock-free ring. The producer is
+// whoever reads stdin (the event loop today); the consumer is the tick.
+template <typename T, size_t N>
+struct SpscRing {
+    static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+    std::array<T, N> buf{};
+    alignas(64) std::atomic<size_t> head{0}; // next slot to read  (consumer)
+    alignas(64) std::atomic<size_t> tail{0}; // next slot to write (producer)
+
+    bool push(const T& v) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N) return false; // full
+        buf[t & (N - 1)] = v;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    bool peek(T& out) const {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        out = buf[h & (N - 1)];
+        return true;
+    }
+    void drop_front() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+    bool pop(T& out) {
+        if (!peek(out)) return false;
+        drop_front();
+        return true;
+    }
+    size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+};
+
+// Decoded input. Arrows and WASD both map to directions.
+enum class Key : uint8_t { Up, Down, Left, Right, Quit, Interrupt };
+
+// A key as decoded from stdin, stamped with the monotonic time it was read.
+struct KeyEvent {
+    Key key;
+    std::chrono::steady_clock::time_point t;
+};
+
+static SpscRing<KeyEvent, 64> in_ring;
+static uint64_t g_keys_dropped = 0;
+static uint64_t g_input_reads  = 0;
+static uint64_t g_input_bytes  = 0;
 atomic<bool> running{true};
 
-optional<char> read_key_now() {
-    unsigned char ch;
-    ssize_t n = read(STDIN_FILENO, &ch, 1);
-    if (n == 1) return static_cast<char>(ch);
-    return nullopt;
-}
-void enqueue(char ch) {
-    ch = static_cast<char>(toupper(static_cast<unsigned char>(ch)));
-    if (ch == 'W' || ch == 'A' || ch == 'S' || ch == 'D' || ch == 'Q') {
-        lock_guard<mutex> lk(in_mtx);
-        in_q.push(ch);
+// Incremental decoder for raw stdin bytes: plain keys, CSI (ESC [ ... final) and
+// SS3 (ESC O x) sequences. State survives between feed() calls, so a sequence split
+// across two reads still decodes. Unknown keys and sequences are swallowed.
+struct InputDecoder {
+    // Str covers DCS/OSC/APC/PM/SOS payloads (terminal replies): swallowed up to ST or BEL
+    enum class St : uint8_t { Ground, Esc, Csi, Ss3, Str, StrEsc };
+    St st{St::Ground};
+
+    template <typename Emit>
+    void feed(const unsigned char* p, size_t n, Emit&& emit) {
+        for (size_t i = 0; i < n; ++i) {
+            unsigned char ch = p[i];
+            switch (st) {
+            case St::Ground:
+                if (ch == 0x1b) { st = St::Esc; break; }
+                if (ch == 3)    { emit(Key::Interrupt); break; }
+                switch (toupper(ch)) {
+                    case 'W': emit(Key::Up);    break;
+                    case 'S': emit(Key::Down);  break;
+                    case 'A': emit(Key::Left);  break;
+                    case 'D': emit(Key::Right); break;
+                    case 'Q': emit(Key::Quit);  break;
+                    default: break;
+                }
+                break;
+            case St::Esc:
+                if (ch == '[')      { st = St::Csi; }
+                else if (ch == 'O') { st = St::Ss3; }
+                else if (ch == 'P' || ch == ']' || ch == '_' || ch == '^' || ch == 'X') { st = St::Str; }
+                else if (ch == 0x1b) {}                       // ESC ESC: still waiting
+                else { st = St::Ground; --i; }                // lone ESC; reprocess byte
+                break;
+            case St::Csi:
+                if (ch >= 0x40 && ch <= 0x7e) {               // final byte
+                    st = St::Ground;
+                    arrow(ch, emit);
+                } else if (ch < 0x20 || ch > 0x3f) {          // not a CSI byte: abort
+                    st = St::Ground; --i;
+                }
+                break;
+            case St::Ss3:
+                st = St::Ground;
+                arrow(ch, emit);
+                break;
+            case St::Str:
+                if (ch == 0x1b)                   st = St::StrEsc;
+                else if (ch == 0x07)              st = St::Ground; // BEL ends an OSC
+                else if (ch == 0x18 || ch == 0x1a) st = St::Ground; // CAN/SUB abort
+                break;
+            case St::StrEsc:
+                if (ch == '\\') st = St::Ground;                     // ST
+                else if (ch != 0x1b) { st = St::Esc; --i; }          // a new sequence cancels the string
+                break;
+            }
+        }
+    }
+
+    template <typename Emit>
+    static void arrow(unsigned char fin, Emit&& emit) {
+        switch (fin) {
+            case 'A': emit(Key::Up);    break;
+            case 'B': emit(Key::Down);  break;
+            case 'C': emit(Key::Right); break;
+            case 'D': emit(Key::Left);  break;
+            default: break;
+        }
+    }
+};
+
+// One read() per readiness wakeup: stdin may be blocking (a pipe, a file), so reading
+// again after a full buffer could stall the loop. Anything left keeps the fd readable
+// and is picked up on the next wakeup. Returns bytes read; 0 is EOF, -1 an error.
+static ssize_t read_input(unsigned char* buf, size_t cap) {
+    for (;;) {
+        ssize_t n = ::read(STDIN_FILENO, buf, cap);
+        g_input_reads++;
+        if (n < 0 && errno == EINTR) continue;
+        if (n > 0) g_input_bytes += (uint64_t)n;
+        return n;
     }
 }
-optional<char> poll_key() {
-    lock_guard<mutex> lk(in_mtx);
-    if (in_q.empty()) return nullopt;
-    char c = in_q.front(); in_q.pop();
-    return c;
+
+// Steering keys go into the ring; returns false for Q / Ctrl-C (quit).
+static bool enqueue(Key k, std::chrono::steady_clock::time_point t) {
+    if (k == Key::Quit || k == Key::Interrupt) return false;
+    if (!in_ring.push(KeyEvent{k, t})) g_keys_dropped++;
+    return true;
 }
 
 // ---------- Helpers ----------
+// Is `name` an executable on PATH? Scanned in-process, like the shell's `command -v`.
 static bool have_cmd(const char* name) {
-    std::string cmd = "command -v ";
-    cmd += name; cmd += " >/dev/null 2>&1";
-    return std::system(cmd.c_str()) == 0;
+    const char* path = std::getenv("PATH");
+    if (!path) return false;
+    std::string file;
+    for (const char* p = path;; ++p) {
+        const char* end = std::strchr(p, ':');
+        if (!end) end = p + std::strlen(p);
+        file.assign(p, end);
+        if (file.empty()) file = "."; // empty entry means the current directory
+        file += '/';
+        file += name;
+        struct stat st{};
+        if (::stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode) && ::access(file.c_str(), X_OK) == 0) return true;
+        if (!*end) return false;
+        p = end;
+    }
 }
 static bool env_set(const char* name) { return std::getenv(name) != nullptr; }
 
-// live terminal size (columns/rows)
-static int term_cols() {
-    winsize ws{};
-    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) return ws.ws_col;
-    return COLS;
+// ---------- Allocation counter ----------
+// Every global operator new bumps g_allocs, so a caller can diff it around a stretch
+// of code (see --alloc-check). One relaxed increment per allocation.
+static std::atomic<uint64_t> g_allocs{0};
+
+void* operator new(std::size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
 }
-static int term_rows() {
+void* operator new[](std::size_t n) { return ::operator new(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+// ---------- Terminal geometry ----------
+// Cached; re-queried only after SIGWINCH (delivered through the event loop below),
+// and only at a frame boundary so the centering never changes mid-frame.
+static volatile sig_atomic_t g_winch_pending = 1; // 1 → query on first use
+static int g_term_cols = COLS;
+static int g_term_rows = ROWS + 6;
+
+// Returns true if the size was (re)read.
+static bool refresh_term_size() {
+    if (!g_winch_pending) return false;
+    g_winch_pending = 0;
     winsize ws{};
-    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0) return ws.ws_row;
-    return ROWS + 6;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0) {
+        if (ws.ws_col > 0) g_term_cols = ws.ws_col;
+        if (ws.ws_row > 0) g_term_rows = ws.ws_row;
+    }
+    return true;
+}
+
+static int term_cols() { return g_term_cols; }
+static int term_rows() { return g_term_rows; }
+
+// ---------- Event loop ----------
+// Blocks in poll() on stdin, the tick deadline and signals, so the process sleeps
+// until there is something to do. Linux uses a timerfd for the deadline and a
+// signalfd for SIGWINCH/SIGINT/SIGTERM; elsewhere the deadline becomes the poll()
+// timeout and signal handlers feed a self-pipe.
+enum : unsigned { EV_INPUT = 1, EV_TIMER = 2, EV_RESIZE = 4, EV_QUIT = 8 };
+
+struct LoopStats {
+    uint64_t wakeups{0};
+    uint64_t input{0};
+    uint64_t timer{0};
+    uint64_t signal{0};
+    uint64_t spurious{0};
+    uint64_t stalls{0};        // pauses after a stall (suspend, slow terminal, ...)
+    uint64_t ticks_skipped{0}; // late ticks beyond the catch-up budget
+};
+static LoopStats g_loop_stats;
+
+#ifndef __linux__
+static int g_sig_pipe_w = -1;
+static volatile sig_atomic_t g_quit_pending = 0;
+static void on_loop_signal(int sig) {
+    if (sig == SIGWINCH) g_winch_pending = 1;
+    else                 g_quit_pending = 1;
+    if (g_sig_pipe_w >= 0) { char b = 1; (void)!::write(g_sig_pipe_w, &b, 1); }
+}
+#endif
+
+// The signals the event loop owns. Every other thread keeps them blocked, so they
+// can only land on the main thread (its signalfd, or its handlers off Linux).
+static void loop_signal_set(sigset_t& set) {
+    sigemptyset(&set);
+    sigaddset(&set, SIGWINCH);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+}
+
+struct EventLoop {
+    bool watch_input{true};
+    std::chrono::steady_clock::time_point deadline{};
+    bool armed{false};
+#ifdef __linux__
+    int tfd{-1};
+    int sfd{-1};
+#else
+    int sig_pipe[2]{-1, -1};
+#endif
+
+    EventLoop() {
+#ifdef __linux__
+        sigset_t mask;
+        loop_signal_set(mask);
+        pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+        sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+#else
+        if (pipe(sig_pipe) == 0) {
+            for (int fd : sig_pipe) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            g_sig_pipe_w = sig_pipe[1];
+        }
+        struct sigaction sa{};
+        sa.sa_handler = on_loop_signal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        sigaction(SIGWINCH, &sa, nullptr);
+        sigaction(SIGINT,   &sa, nullptr);
+        sigaction(SIGTERM,  &sa, nullptr);
+#endif
+    }
+    ~EventLoop() {
+#ifdef __linux__
+        if (tfd >= 0) close(tfd);
+        if (sfd >= 0) close(sfd);
+#else
+        g_sig_pipe_w = -1;
+        for (int fd : sig_pipe) if (fd >= 0) close(fd);
+#endif
+    }
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Wake with EV_TIMER once `when` (steady_clock) has passed.
+    void arm(std::chrono::steady_clock::time_point when) {
+        deadline = when;
+        armed = true;
+#ifdef __linux__
+        // steady_clock is CLOCK_MONOTONIC on Linux, so its epoch offsets map 1:1.
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(when.time_since_epoch()).count();
+        if (ns <= 0) ns = 1;
+        itimerspec its{};
+        its.it_value.tv_sec  = (time_t)(ns / 1000000000);
+        its.it_value.tv_nsec = (long)(ns % 1000000000);
+        timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, nullptr);
+#endif
+    }
+    void disarm() {
+        armed = false;
+#ifdef __linux__
+        itimerspec its{};
+        timerfd_settime(tfd, 0, &its, nullptr);
+#endif
+    }
+
+    // Block until at least one event; returns a mask of EV_* bits (0 on EINTR).
+    unsigned wait() {
+        pollfd fds[3];
+        int n = 0, in_i = -1, aux_i = -1;
+        if (watch_input) { in_i = n; fds[n++] = { STDIN_FILENO, POLLIN, 0 }; }
+        int timeout = -1;
+#ifdef __linux__
+        int t_i = n;
+        fds[n++] = { tfd, POLLIN, 0 };
+        aux_i = n;
+        fds[n++] = { sfd, POLLIN, 0 };
+#else
+        aux_i = n;
+        fds[n++] = { sig_pipe[0], POLLIN, 0 };
+        if (armed) {
+            auto left = deadline - std::chrono::steady_clock::now();
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(left).count();
+            if (left > std::chrono::milliseconds(ms)) ++ms; // round up: never wake early
+            timeout = (int)std::max<long long>(0, ms);
+        }
+#endif
+        int rc = poll(fds, (nfds_t)n, timeout);
+        g_loop_stats.wakeups++;
+        if (rc < 0) return 0;
+
+        unsigned ev = 0;
+        if (in_i >= 0 && (fds[in_i].revents & (POLLIN | POLLHUP | POLLERR))) ev |= EV_INPUT;
+#ifdef __linux__
+        if (fds[t_i].revents & POLLIN) {
+            uint64_t expirations;
+            (void)!::read(tfd, &expirations, sizeof expirations);
+            armed = false;
+            ev |= EV_TIMER;
+        }
+        if (fds[aux_i].revents & POLLIN) {
+            signalfd_siginfo si;
+            while (::read(sfd, &si, sizeof si) == (ssize_t)sizeof si) {
+                if (si.ssi_signo == SIGWINCH) { g_winch_pending = 1; ev |= EV_RESIZE; }
+                else                          ev |= EV_QUIT;
+            }
+        }
+#else
+        if (fds[aux_i].revents & POLLIN) {
+            char buf[64];
+            while (::read(sig_pipe[0], buf, sizeof buf) > 0) {}
+            if (g_winch_pending) ev |= EV_RESIZE;
+            if (g_quit_pending)  ev |= EV_QUIT;
+        }
+        if (armed && std::chrono::steady_clock::now() >= deadline) { armed = false; ev |= EV_TIMER; }
+#endif
+        if (ev & EV_INPUT) g_loop_stats.input++;
+        if (ev & EV_TIMER) g_loop_stats.timer++;
+        if (ev & (EV_RESIZE | EV_QUIT)) g_loop_stats.signal++;
+        if (!ev) g_loop_stats.spurious++;
+        return ev;
+    }
+};
+
+static void dump_loop_stats() {
+    const LoopStats& s = g_loop_stats;
+    std::cerr << "[loop] wakeups=" << s.wakeups
+              << " input=" << s.input
+              << " timer=" << s.timer
+              << " signal=" << s.signal
+              << " spurious=" << s.spurious
+              << " stalls=" << s.stalls
+              << " ticks_skipped=" << s.ticks_skipped
+              << " input_reads=" << g_input_reads
+              << " input_bytes=" << g_input_bytes
+              << " keys_dropped=" << g_keys_dropped << "\n";
+}
+
+// padding in one write instead of one ' ' at a time
+static void put_spaces(int n) {
+    static const char SPACES[] = "                                                                ";
+    constexpr int CHUNK = (int)sizeof(SPACES) - 1;
+    for (; n > 0; n -= CHUNK) std::cout.write(SPACES, std::min(n, CHUNK));
 }
 
 // centered print
 static void center_line(const std::string& s) {
     int w = term_cols();
     int pad = std::max(0, (int)(w - (int)s.size()) / 2);
-    for (int i = 0; i < pad; ++i) std::cout << ' ';
+    put_spaces(pad);
     std::cout << s << "\n";
 }
 
+// ---------- Screen: front/back cell buffers ----------
+// Every frame is composed into `back`; present() emits only the cells that differ
+// from `front` (what the terminal currently shows) and then swaps them.
+struct Style {
+    uint16_t fg{C_DEFAULT};
+    uint16_t bg{C_DEFAULT};
+    uint8_t  attr{0};
+    bool operator==(const Style& o) const { return fg == o.fg && bg == o.bg && attr == o.attr; }
+    bool operator!=(const Style& o) const { return !(*this == o); }
+};
+
+struct Cell {
+    char    g[4]{' ', 0, 0, 0}; // UTF-8 glyph bytes
+    uint8_t n{1};               // glyph byte count
+    uint8_t w{1};               // columns: 2 = wide glyph, 0 = right half of a wide glyph
+    Style   st{};
+    bool operator==(const Cell& o) const {
+        return n == o.n && w == o.w && st == o.st && std::memcmp(g, o.g, n) == 0;
+    }
+    bool operator!=(const Cell& o) const { return !(*this == o); }
+};
+
+// ---------- Frame output arena ----------
+// One preallocated byte buffer reused for every frame and handed to a single write().
+struct FrameBuf {
+    std::vector<char> buf;
+    size_t len{0};
+
+    explicit FrameBuf(size_t cap = 256 * 1024) : buf(cap) {}
+
+    void clear() { len = 0; }
+    void ensure(size_t n) {
+        if (len + n > buf.size()) buf.resize(std::max(buf.size() * 2, len + n)); // only on huge terminals
+    }
+    void put(char ch) { ensure(1); buf[len++] = ch; }
+    void put(const char* s, size_t n) { ensure(n); std::memcpy(&buf[len], s, n); len += n; }
+    void put(const char* s) { put(s, std::strlen(s)); }
+
+    // Write everything to fd; retries partial writes and EINTR.
+    bool flush(int fd) {
+        size_t off = 0;
+        while (off < len) {
+            ssize_t n = ::write(fd, buf.data() + off, len - off);
+            if (n < 0) { if (errno == EINTR) continue; return false; }
+            off += (size_t)n;
+        }
+        len = 0;
+        return true;
+    }
+};
+
+// SGR parameter list assembled on the stack ("1;38;5;208;44" etc.).
+struct SgrParams {
+    char b[48];
+    int  n{0};
+    void num(unsigned v) {
+        if (n) b[n++] = ';';
+        char tmp[12]; int k = 0;
+        do { tmp[k++] = (char)('0' + v % 10); v /= 10; } while (v);
+        while (k) b[n++] = tmp[--k];
+    }
+    void color(uint16_t c, bool bg) {
+        unsigned idx = (unsigned)(c - 1);
+        if (idx < 8)       num((bg ? 40 : 30) + idx);
+        else if (idx < 16) num((bg ? 100 : 90) + idx - 8);
+        else { num(bg ? 48 : 38); num(5); num(idx); }
+    }
+};
+
+// Tracks the terminal's current SGR state so the encoder only emits real changes,
+// choosing between an incremental delta and "reset + full style", whichever is shorter.
+struct SgrTracker {
+    Style cur{};
+    bool  known{false};
+
+    void forget() { known = false; }
+
+    void to(FrameBuf& out, Style want) {
+        if (known && want == cur) return;
+
+        SgrParams full;
+        full.num(0);
+        if (want.fg) full.color(want.fg, false);
+        if (want.bg) full.color(want.bg, true);
+        if (want.attr & A_BOLD)    full.num(1);
+        if (want.attr & A_REVERSE) full.num(7);
+
+        const SgrParams* pick = &full;
+        SgrParams delta;
+        if (known) {
+            uint8_t off = cur.attr & ~want.attr, on = want.attr & ~cur.attr;
+            if (off & A_BOLD)    delta.num(22);
+            if (off & A_REVERSE) delta.num(27);
+            if (on & A_BOLD)     delta.num(1);
+            if (on & A_REVERSE)  delta.num(7);
+            if (want.fg != cur.fg) { if (want.fg) delta.color(want.fg, false); else delta.num(39); }
+            if (want.bg != cur.bg) { if (want.bg) delta.color(want.bg, true);  else delta.num(49); }
+            if (delta.n < full.n) pick = &delta;
+        }
+
+        out.put("\x1b[", 2);
+        out.put(pick->b, (size_t)pick->n);
+        out.put('m');
+        cur = want;
+        known = true;
+    }
+};
+
+// status line + top border + playfield + bottom border + up to 3 message lines + HUD
+static constexpr int SCREEN_LINES = ROWS + 7;
+static constexpr int HUD_LINE = SCREEN_LINES - 1;
+
+struct Screen {
+    int width{0};
+    std::vector<Cell> front, back;
+    bool need_full{true};
+    SgrTracker sgr;         // terminal attribute state as of the last presented frame
+    int term_h{0};          // terminal rows (LF is only used above the last one)
+    int cur_r{0}, cur_c{0}; // terminal cursor position, valid while cur_known
+    bool cur_known{false};
+
+    // (Re)size to the terminal width; any change forces a full repaint.
+    void resize(int w, int h) {
+        if (w == width && h == term_h && !back.empty()) return;
+        width = w;
+        term_h = h;
+        cur_known = false;
+        front.assign((size_t)width * SCREEN_LINES, Cell{});
+        back.assign((size_t)width * SCREEN_LINES, Cell{});
+        need_full = true;
+    }
+    void clear() { std::fill(back.begin(), back.end(), Cell{}); }
+
+    Cell& at(int r, int c) { return back[(size_t)r * width + c]; }
+    bool in_bounds(int r, int c) const { return r >= 0 && r < SCREEN_LINES && c >= 0 && c < width; }
+
+    // Overwriting either half of a wide glyph blanks the other half, so the buffer
+    // never holds an orphaned half that present() can't repaint.
+    void unlink(int r, int c) {
+        const Cell& cell = at(r, c);
+        if (cell.w == 2 && c + 1 < width) at(r, c + 1) = Cell{};
+        if (cell.w == 0 && c > 0)         at(r, c - 1) = Cell{};
+    }
+    void put(int r, int c, const char* glyph, Style st) {
+        if (!in_bounds(r, c)) return;
+        unlink(r, c);
+        Cell& cell = at(r, c);
+        cell.n = (uint8_t)std::min<size_t>(4, std::strlen(glyph));
+        std::memcpy(cell.g, glyph, cell.n);
+        cell.w = 1;
+        cell.st = st;
+    }
+    void put(int r, int c, char ch, Style st) {
+        char g[2] = { ch, 0 };
+        put(r, c, g, st);
+    }
+    // Double-width glyph: occupies (r,c) and (r,c+1).
+    void put_wide(int r, int c, const char* glyph, Style st) {
+        if (!in_bounds(r, c + 1)) return;
+        unlink(r, c + 1);
+        put(r, c, glyph, st);
+        at(r, c).w = 2;
+        Cell& half = at(r, c + 1);
+        half = Cell{};
+        half.n = 0; half.w = 0; half.st = st;
+    }
+    // ASCII text; returns the column after the last character.
+    int text(int r, int c, const char* s, Style st) {
+        for (; *s; ++s) put(r, c++, *s, st);
+        return c;
+    }
+    void center(int r, const char* s, Style st = {}) {
+        text(r, std::max(0, (width - (int)std::strlen(s)) / 2), s, st);
+    }
+};
+
+struct RenderStats {
+    uint64_t frames{0};
+    uint64_t full_repaints{0};
+    uint64_t bytes_total{0};
+    uint64_t last_bytes{0};
+    uint64_t max_bytes{0};
+    uint64_t last_encode_ns{0};
+    uint64_t encode_ns_total{0};
+    uint64_t writes{0};
+};
+static RenderStats g_render_stats;
+
+// ---------- Cursor motion ----------
+// Candidate byte sequence for one cursor move; too-long candidates just drop out.
+struct MoveSeq {
+    char b[96];
+    int  n{0};
+    bool ok{true};
+    void put(const char* s, int k) {
+        if (!ok || n + k > (int)sizeof b) { ok = false; return; }
+        std::memcpy(b + n, s, (size_t)k); n += k;
+    }
+    void put(char ch) { put(&ch, 1); }
+    void num(unsigned v) {
+        char t[12]; int k = 0;
+        do { t[k++] = (char)('0' + v % 10); v /= 10; } while (v);
+        while (k) put(t[--k]);
+    }
+    void csi(unsigned count, char fin) { // CUU/CUD/CUF/CUB; a count of 1 is implied
+        put("\x1b[", 2);
+        if (count != 1) num(count);
+        put(fin);
+    }
+    bool better_than(const MoveSeq& o) const { return ok && (!o.ok || n < o.n); }
+};
+
+// Move right from `from` to `to` on one row: CUF, or re-send the unchanged glyphs in
+// between when they share the current SGR state and that is shorter.
+static void move_right(MoveSeq& m, const Cell* row, int from, int to, Style cur) {
+    if (to == from) return;
+    if (to < from) { m.csi((unsigned)(from - to), 'D'); return; }
+
+    MoveSeq cuf;
+    cuf.csi((unsigned)(to - from), 'C');
+
+    MoveSeq rewrite;
+    bool can_rewrite = row[from].w != 0;
+    for (int c = from; can_rewrite && c < to; ) {
+        const Cell& cell = row[c];
+        if (cell.st != cur || c + cell.w > to) { can_rewrite = false; break; }
+        rewrite.put(cell.g, cell.n);
+        if (!rewrite.ok) { can_rewrite = false; break; }
+        c += cell.w;
+    }
+    m.put(can_rewrite && rewrite.n < cuf.n ? rewrite.b : cuf.b,
+          can_rewrite && rewrite.n < cuf.n ? rewrite.n : cuf.n);
+}
+
+// Emit the cheapest way to get the cursor from where it is to (r, c): absolute CUP,
+// relative CUU/CUD + CUF/CUB, CR (+LF) then forward, or rewriting unchanged cells.
+static void move_cursor(Screen& scr, FrameBuf& out, int r, int c) {
+    if (scr.cur_known && scr.cur_r == r && scr.cur_c == c) return;
+
+    MoveSeq best;
+    best.put("\x1b[", 2);
+    if (r != 0 || c != 0) {
+        best.num((unsigned)r + 1);
+        if (c != 0) { best.put(';'); best.num((unsigned)c + 1); }
+    }
+    best.put('H');
+
+    if (scr.cur_known) {
+        const Cell* row = &scr.back[(size_t)r * scr.width];
+        const Style cur = scr.sgr.cur;
+        const int dr = r - scr.cur_r;
+
+        // vertical, then horizontal from the current column
+        MoveSeq rel;
+        if (dr != 0) rel.csi((unsigned)std::abs(dr), dr < 0 ? 'A' : 'B');
+        move_right(rel, row, scr.cur_c, c, cur);
+        if (rel.better_than(best)) best = rel;
+
+        // vertical, then CR and forward from column 0
+        if (c < scr.cur_c) {
+            MoveSeq cr;
+            if (dr != 0) cr.csi((unsigned)std::abs(dr), dr < 0 ? 'A' : 'B');
+            cr.put('\r');
+            move_right(cr, row, 0, c, cur);
+            if (cr.better_than(best)) best = cr;
+        }
+
+        // CR LF down to the target row (never from the bottom line, which would scroll)
+        if (dr > 0 && r < scr.term_h) {
+            MoveSeq lf;
+            for (int i = 0; i < dr; ++i) lf.put("\r\n", 2);
+            move_right(lf, row, 0, c, cur);
+            if (lf.better_than(best)) best = lf;
+        }
+    }
+
+    out.put(best.b, (size_t)best.n);
+    scr.cur_r = r;
+    scr.cur_c = c;
+    scr.cur_known = true;
+}
+
+// Encode the difference between front and back into `out`, then make back the new front.
+// The first frame (and any frame after a resize) clears the terminal and diffs against blanks.
+static void present(Screen& scr, FrameBuf& out) {
+    auto t0 = std::chrono::steady_clock::now();
+    out.clear();
+    if (scr.need_full) {
+        out.put("\x1b[0m\x1b[2J");
+        scr.cur_known = false;
+        scr.sgr.cur = Style{};
+        scr.sgr.known = true;
+        std::fill(scr.front.begin(), scr.front.end(), Cell{});
+        scr.need_full = false;
+        g_render_stats.full_repaints++;
+    }
+
+    const int W = scr.width;
+    const int H = scr.term_h > 0 ? std::min(SCREEN_LINES, scr.term_h) : SCREEN_LINES; // rows below the terminal are clipped
+    for (int r = 0; r < H; ++r) {
+        const Cell* f = &scr.front[(size_t)r * W];
+        const Cell* b = &scr.back[(size_t)r * W];
+        int c = 0;
+        while (c < W) {
+            if (f[c] == b[c]) { ++c; continue; }
+            if (b[c].w == 0 && c > 0 && b[c - 1].w == 2) --c; // start on the left half of a wide glyph
+            move_cursor(scr, out, r, c);
+            // The first cell is always emitted (it may be an unchanged left half); a
+            // wide glyph's right half is covered by advancing past it.
+            do {
+                scr.sgr.to(out, b[c].st);
+                if (b[c].w == 0) out.put(' ');  // stray right half: paint it blank
+                else             out.put(b[c].g, b[c].n);
+                c += std::max<int>(1, b[c].w);
+            } while (c < W && f[c] != b[c]);
+            scr.cur_c = c;
+            if (c >= W) scr.cur_known = false; // pending-wrap state at the right margin
+        }
+    }
+    scr.front.swap(scr.back);
+
+    RenderStats& s = g_render_stats;
+    s.frames++;
+    s.last_bytes = out.len;
+    s.bytes_total += out.len;
+    s.max_bytes = std::max<uint64_t>(s.max_bytes, out.len);
+    s.last_encode_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - t0).count();
+    s.encode_ns_total += s.last_encode_ns;
+}
+
+static void dump_render_stats() {
+    const RenderStats& s = g_render_stats;
+    if (s.frames == 0) return;
+    std::cerr << "[render] frames=" << s.frames
+              << " full_repaints=" << s.full_repaints
+              << " bytes_total=" << s.bytes_total
+              << " avg_bytes/frame=" << (s.bytes_total / s.frames)
+              << " max_bytes=" << s.max_bytes
+              << " last_bytes=" << s.last_bytes
+              << " writes=" << s.writes
+              << " avg_encode_us=" << (s.encode_ns_total / s.frames / 1000.0) << "\n";
+}
+
 // --- tiny file->string and base64 for iTerm2 inline image ---
 static bool read_file(const char* path, std::string& out) {
     FILE* f = std::fopen(path, "rb");
@@ -336,10 +1107,725 @@ static std::string b64_encode(const std::string& in) {
     }
     return out;
 }
-static bool is_iterm() { return std::getenv("ITERM_SESSION_ID") != nullptr; }
+
+// ---------- Terminal capabilities ----------
+// Which inline-image protocols the terminal speaks. Decided once at startup from the
+// environment; only when that is inconclusive is the terminal asked directly
+// (XTVERSION, with DA1 as the reply everyone sends, so we know when to stop waiting).
+static constexpr int CAPS_QUERY_MS = 100;  // give up on a silent terminal after this
+static constexpr int CAPS_LATE_MS  = 3000; // ...but drop its reply if it turns up within this
+
+struct TermCaps {
+    bool iterm_images{false}; // OSC 1337 File=
+    bool kitty_images{false}; // kitty graphics protocol (APC G)
+    bool sixel{false};        // DA1 attribute 4
+    bool queried{false};
+    bool answered{false};
+    char version[64]{};       // XTVERSION name, e.g. "kitty(0.35.2)"
+    double probe_ms{0};
+
+    // Query timed out: its reply may still be on the way (slow links, ssh)
+    bool pending{false};
+    std::chrono::steady_clock::time_point pending_until{};
+    enum class Late : uint8_t { Ground, Esc, Csi, Da1, Str, StrEsc };
+    Late late_st{Late::Ground};
+    uint64_t late_bytes{0};
+
+    // Feed one byte. Returns whether it belongs to an escape sequence (a reply to be
+    // dropped); `da1` is set when it completes the DA1 reply that ends the query.
+    bool scan_reply(unsigned char ch, bool& da1) {
+        switch (late_st) {
+        case Late::Ground:
+            if (ch != 0x1b) return false;
+            late_st = Late::Esc;
+            return true;
+        case Late::Esc:
+            if (ch == '[')                                 late_st = Late::Csi;
+            else if (ch == 'P' || ch == ']' || ch == '_') late_st = Late::Str;
+            else if (ch != 0x1b)                           late_st = Late::Ground;
+            return true;
+        case Late::Csi:
+        case Late::Da1:
+            if (ch == '?' && late_st == Late::Csi) late_st = Late::Da1;
+            else if (ch >= 0x40 && ch <= 0x7e) {
+                da1 = ch == 'c' && late_st == Late::Da1;
+                late_st = Late::Ground;
+            }
+            return true;
+        case Late::Str:
+            if (ch == 0x1b) late_st = Late::StrEsc;
+            else if (ch == 0x07) late_st = Late::Ground;
+            return true;
+        case Late::StrEsc:
+            late_st = ch == '\\' ? Late::Ground : Late::Str;
+            return true;
+        }
+        return false;
+    }
+};
+static TermCaps g_caps;
+
+static bool starts_with(const char* s, const char* prefix) {
+    return std::strncmp(s, prefix, std::strlen(prefix)) == 0;
+}
+
+static void caps_from_name(TermCaps& c, const char* name) {
+    if (starts_with(name, "iTerm")) c.iterm_images = true;
+    if (starts_with(name, "kitty")) c.kitty_images = true;
+    if (starts_with(name, "WezTerm")) c.iterm_images = c.kitty_images = true;
+}
+
+// Pull the XTVERSION (DCS > | name ST) and DA1 (CSI ? attrs c) replies out of `buf`.
+// Returns true once the DA1 reply is complete.
+static bool parse_caps_reply(TermCaps& c, const std::string& buf) {
+    size_t v = buf.find("\x1bP>|");
+    if (v != std::string::npos) {
+        size_t end = buf.find('\x1b', v + 4);
+        if (end != std::string::npos) {
+            size_t n = std::min(end - (v + 4), sizeof c.version - 1);
+            std::memcpy(c.version, buf.data() + v + 4, n);
+            c.version[n] = 0;
+        }
+    }
+    size_t d = buf.find("\x1b[?");
+    if (d == std::string::npos) return false;
+    size_t end = buf.find('c', d);
+    if (end == std::string::npos) return false;
+    for (size_t i = d + 3; i < end;) {
+        size_t j = buf.find(';', i);
+        if (j == std::string::npos || j > end) j = end;
+        if (buf.compare(i, j - i, "4") == 0) c.sixel = true;
+        i = j + 1;
+    }
+    return true;
+}
+
+// Needs the terminal in raw mode (no echo, unbuffered) for the query.
+static void detect_term_caps(bool can_query) {
+    using namespace std::chrono;
+    TermCaps& c = g_caps;
+    const char* prog = std::getenv("TERM_PROGRAM");
+    const char* term = std::getenv("TERM");
+    if (env_set("ITERM_SESSION_ID")) c.iterm_images = true;
+    if (env_set("KITTY_WINDOW_ID") || (term && std::strcmp(term, "xterm-kitty") == 0)) c.kitty_images = true;
+    if (prog) caps_from_name(c, std::strcmp(prog, "iTerm.app") == 0 ? "iTerm" : prog);
+    if (c.iterm_images || c.kitty_images) return; // the environment settled it
+    if (!can_query || !isatty(STDOUT_FILENO) || (term && std::strcmp(term, "dumb") == 0)) return;
+
+    auto t0 = steady_clock::now();
+    auto deadline = t0 + milliseconds(CAPS_QUERY_MS);
+    static const char query[] = "\x1b[>0q\x1b[c";
+    if (::write(STDOUT_FILENO, query, sizeof query - 1) != (ssize_t)(sizeof query - 1)) return;
+    c.queried = true;
+    // Anything else read meanwhile is typeahead; the splash waits for a fresh key anyway.
+    std::string reply;
+    while (!c.answered) {
+        int left = (int)duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+        if (left <= 0) break;
+        pollfd pfd{ STDIN_FILENO, POLLIN, 0 };
+        if (poll(&pfd, 1, left) <= 0) break;
+        unsigned char buf[256];
+        ssize_t n = read_input(buf, sizeof buf);
+        if (n <= 0) break;
+        reply.append((const char*)buf, (size_t)n);
+        c.answered = parse_caps_reply(c, reply);
+    }
+    c.probe_ms = duration<double, std::milli>(steady_clock::now() - t0).count();
+    if (c.version[0]) caps_from_name(c, c.version);
+    if (!c.answered) {
+        c.pending = true;
+        c.pending_until = steady_clock::now() + milliseconds(CAPS_LATE_MS);
+        bool da1 = false;
+        for (char ch : reply) c.scan_reply((unsigned char)ch, da1); // resume mid-reply
+    }
+}
+
+// While a timed-out query's reply may still arrive, strip escape sequences from the
+// input so the reply can't pass for a keypress; plain keys still get through. Ends at
+// the reply's DA1 terminator. Returns the bytes kept, compacted to the front of buf.
+static size_t drop_late_caps_reply(unsigned char* buf, size_t n) {
+    TermCaps& c = g_caps;
+    if (!c.pending) return n;
+    if (std::chrono::steady_clock::now() > c.pending_until) {
+        c.pending = false;
+        return n;
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < n; ++i) {
+        bool da1 = false;
+        if (!c.pending || !c.scan_reply(buf[i], da1)) {
+            buf[kept++] = buf[i];
+            continue;
+        }
+        c.late_bytes++;
+        if (da1) c.pending = false;
+    }
+    return kept;
+}
+
+static void dump_caps() {
+    const TermCaps& c = g_caps;
+    std::fprintf(stderr, "[caps] iterm_images=%d kitty_images=%d sixel=%d queried=%d answered=%d version=\"%s\" probe_ms=%.2f late_bytes=%llu\n",
+                 c.iterm_images, c.kitty_images, c.sixel, c.queried, c.answered, c.version, c.probe_ms,
+                 (unsigned long long)c.late_bytes);
+}
+
+// ---------- Audio engine ----------
+// Clips are decoded once at startup (WAV, plus AIFF for the macOS system sounds) into
+// mono 16-bit PCM at AUDIO_RATE. The game only pushes small commands onto a lock-free
+// ring; a dedicated thread mixes every active voice in 10 ms blocks and hands them to
+// a sink. Nothing on the game loop forks, execs or touches the disk to make a sound.
+static constexpr int AUDIO_BLOCK = AUDIO_RATE / 100; // 10 ms
+static constexpr int AUDIO_LEAD_BLOCKS = 3;          // silence written up front so pipes never starve
+static constexpr int MAX_VOICES  = 32;
+
+struct Clip {
+    bool loaded{false};
+    std::string path;
+    const int16_t* pcm{nullptr}; // into `owned`, or straight into the asset pack
+    size_t len{0};
+    std::vector<int16_t> owned;
+};
+
+// Where each Sfx comes from: an asset, or (asset == Count) a system sound name.
+struct SfxSource { Asset asset; const char* system; };
+static constexpr SfxSource SFX_SOURCES[] = {
+    { Asset::PoopWav,  nullptr }, { Asset::NomWav,   nullptr },
+    { Asset::NastyWav, nullptr }, { Asset::GrossWav, nullptr },
+    { Asset::Count, "Pop" },   { Asset::Count, "Bottle" },    { Asset::Count, "Funk" },
+    { Asset::Count, "Tink" },  { Asset::Count, "Ping" },      { Asset::Count, "Submarine" },
+    { Asset::Count, "Purr" },  { Asset::Count, "Glass" },     { Asset::Count, "Hero" },
+    { Asset::Count, "Basso" },
+};
+static_assert(sizeof(SFX_SOURCES) / sizeof(SFX_SOURCES[0]) == (size_t)Sfx::Count, "one source per Sfx");
+
+static uint32_t rd_le(const unsigned char* p, int n) { uint32_t v = 0; for (int i = n - 1; i >= 0; --i) v = (v << 8) | p[i]; return v; }
+static uint32_t rd_be(const unsigned char* p, int n) { uint32_t v = 0; for (int i = 0; i < n; ++i) v = (v << 8) | p[i]; return v; }
+
+// Layout of interleaved PCM as found in a WAV/AIFF data chunk.
+struct PcmFormat {
+    int channels{0};
+    int bits{0};
+    bool is_float{false};
+    bool big_endian{false};
+    double rate{0};
+    size_t frame_bytes() const { return (size_t)(bits / 8 * channels); }
+};
+
+// One frame (all channels averaged) as a float in [-1, 1].
+static float read_frame(const unsigned char* data, size_t frame, const PcmFormat& fmt) {
+    const int bps = fmt.bits / 8;
+    const unsigned char* p = data + frame * fmt.frame_bytes();
+    float acc = 0;
+    for (int ch = 0; ch < fmt.channels; ++ch, p += bps) {
+        uint32_t u = fmt.big_endian ? rd_be(p, bps) : rd_le(p, bps);
+        float x;
+        if (fmt.is_float) {
+            std::memcpy(&x, &u, sizeof x);
+        } else if (fmt.bits == 8) {
+            x = ((int)u - 128) / 128.0f;                  // 8-bit PCM is unsigned
+        } else {
+            int32_t v = (int32_t)(u << (32 - fmt.bits)); // sign-extend via the top bits
+            x = (float)v / 2147483648.0f;
+        }
+        acc += x;
+    }
+    return acc / (float)fmt.channels;
+}
+
+static int16_t to_s16(float x) { return (int16_t)std::max(-32768.0f, std::min(32767.0f, x * 32767.0f)); }
+
+// Whole buffer → mono int16 at AUDIO_RATE (linear resample).
+static void pcm_to_mono(const unsigned char* data, size_t bytes, const PcmFormat& fmt, std::vector<int16_t>& out) {
+    const size_t frames = bytes / fmt.frame_bytes();
+    const double step = fmt.rate / AUDIO_RATE;
+    const size_t n = frames ? (size_t)((double)(frames - 1) / step) + 1 : 0;
+    out.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        double pos = (double)i * step;
+        size_t j = (size_t)pos;
+        float a = read_frame(data, j, fmt);
+        float b = j + 1 < frames ? read_frame(data, j + 1, fmt) : a;
+        out[i] = to_s16(a + (b - a) * (float)(pos - (double)j));
+    }
+}
+
+// Locate the sample data of a RIFF/WAVE image without copying it.
+static bool parse_wav(const unsigned char* d, size_t n, PcmFormat& fmt, const unsigned char*& data, size_t& bytes) {
+    if (n < 12 || std::memcmp(d, "RIFF", 4) != 0 || std::memcmp(d + 8, "WAVE", 4) != 0) return false;
+    int tag = 0;
+    for (size_t i = 12; i + 8 <= n;) {
+        uint32_t sz = rd_le(d + i + 4, 4);
+        const unsigned char* body = d + i + 8;
+        size_t avail = std::min<size_t>(sz, n - i - 8);
+        if (std::memcmp(d + i, "fmt ", 4) == 0 && avail >= 16) {
+            tag = (int)rd_le(body, 2);
+            fmt.channels = (int)rd_le(body + 2, 2);
+            fmt.rate = rd_le(body + 4, 4);
+            fmt.bits = (int)rd_le(body + 14, 2);
+            if (tag == 0xFFFE && avail >= 26) tag = (int)rd_le(body + 24, 2); // WAVE_FORMAT_EXTENSIBLE
+            fmt.is_float = tag == 3;
+        } else if (std::memcmp(d + i, "data", 4) == 0) {
+            const int b = fmt.bits;
+            if (fmt.channels <= 0 || fmt.rate <= 0) return false;
+            if (!((tag == 1 && (b == 8 || b == 16 || b == 24 || b == 32)) || (tag == 3 && b == 32))) return false;
+            data = body;
+            bytes = avail - avail % fmt.frame_bytes();
+            return true;
+        }
+        i += 8 + (size_t)sz + (sz & 1);
+    }
+    return false;
+}
+
+static bool decode_wav(const std::string& file, std::vector<int16_t>& out) {
+    PcmFormat fmt;
+    const unsigned char* data;
+    size_t bytes;
+    if (!parse_wav((const unsigned char*)file.data(), file.size(), fmt, data, bytes)) return false;
+    pcm_to_mono(data, bytes, fmt, out);
+    return true;
+}
+
+// AIFF/AIFC (uncompressed, 'sowt' little-endian or 'fl32' float).
+static bool decode_aiff(const std::string& file, std::vector<int16_t>& out) {
+    const unsigned char* d = (const unsigned char*)file.data();
+    const size_t n = file.size();
+    if (n < 12 || std::memcmp(d, "FORM", 4) != 0) return false;
+    const bool aifc = std::memcmp(d + 8, "AIFC", 4) == 0;
+    if (!aifc && std::memcmp(d + 8, "AIFF", 4) != 0) return false;
+    PcmFormat fmt;
+    fmt.big_endian = true;
+    for (size_t i = 12; i + 8 <= n;) {
+        uint32_t sz = rd_be(d + i + 4, 4);
+        const unsigned char* body = d + i + 8;
+        size_t avail = std::min<size_t>(sz, n - i - 8);
+        if (std::memcmp(d + i, "COMM", 4) == 0 && avail >= 18) {
+            fmt.channels = (int)rd_be(body, 2);
+            fmt.bits = (int)rd_be(body + 6, 2);
+            // 80-bit IEEE extended sample rate
+            int exp = (int)(rd_be(body + 8, 2) & 0x7FFF);
+            uint64_t mant = ((uint64_t)rd_be(body + 10, 4) << 32) | rd_be(body + 14, 4);
+            fmt.rate = std::ldexp((double)mant, exp - 16383 - 63);
+            if (aifc && avail >= 22) {
+                if (std::memcmp(body + 18, "sowt", 4) == 0) fmt.big_endian = false;
+                else if (std::memcmp(body + 18, "fl32", 4) == 0 || std::memcmp(body + 18, "FL32", 4) == 0) fmt.is_float = true;
+                else if (std::memcmp(body + 18, "NONE", 4) != 0) return false;
+            }
+        } else if (std::memcmp(d + i, "SSND", 4) == 0 && avail >= 8) {
+            if (fmt.channels <= 0 || fmt.rate <= 0 || fmt.bits % 8 != 0 || fmt.bits < 8 || fmt.bits > 32) return false;
+            size_t off = 8 + rd_be(body, 4);
+            if (off > avail) return false;
+            if (fmt.bits == 8) {
+                // AIFF 8-bit is signed; shift to the unsigned form read_frame() expects
+                std::string u(file, (size_t)(body - d) + off, avail - off);
+                for (char& c : u) c = (char)((unsigned char)c ^ 0x80);
+                pcm_to_mono((const unsigned char*)u.data(), u.size(), fmt, out);
+            } else {
+                pcm_to_mono(body + off, avail - off, fmt, out);
+            }
+            return true;
+        }
+        i += 8 + (size_t)sz + (sz & 1);
+    }
+    return false;
+}
+
+// A looped track streamed straight out of a read-only mapping of its WAV file. Each
+// mixer block decodes only the frames it needs, so memory stays flat however long the
+// track is, and starting, stopping or fading it only moves a gain target.
+struct MusicStream {
+    void* map{MAP_FAILED}; // own mapping; unused when the WAV lives in the asset pack
+    size_t map_len{0};
+    const char* path{nullptr};
+    const unsigned char* data{nullptr};
+    size_t frames{0};
+    PcmFormat fmt;
+    double pos{0};   // source frame
+    float gain{0};   // current gain; moves toward target by `ramp` once per block
+    float target{0};
+    float ramp{0};
+    pid_t pid{-1};   // spawn sink: the afplay currently playing it
+
+    // Stream from a WAV image already in memory.
+    bool attach(const unsigned char* wav, size_t len, const char* p) {
+        size_t bytes = 0;
+        if (!parse_wav(wav, len, fmt, data, bytes) || bytes == 0) return false;
+        frames = bytes / fmt.frame_bytes();
+        path = p;
+        return true;
+    }
+    bool open(const char* p) {
+        size_t len = 0;
+        void* m = map_file(p, len);
+        if (m == MAP_FAILED) return false;
+        if (!attach((const unsigned char*)m, len, p)) {
+            munmap(m, len);
+            return false;
+        }
+        (void)madvise(m, len, MADV_SEQUENTIAL);
+        map = m;
+        map_len = len;
+        return true;
+    }
+    void close() {
+        if (map != MAP_FAILED) munmap(map, map_len);
+        map = MAP_FAILED;
+        data = nullptr;
+        frames = 0;
+    }
+    bool ready() const { return frames > 0; }
+    bool audible() const { return gain > 0 || target > 0; }
+
+    // Add one block. Past the last frame it carries straight on from the first (and
+    // interpolates across the seam), so the loop point has no gap.
+    void mix(int32_t* acc) {
+        const float g0 = gain;
+        if (gain < target) gain = std::min(target, gain + ramp);
+        else if (gain > target) gain = std::max(target, gain - ramp);
+        const double step = fmt.rate / AUDIO_RATE;
+        for (int i = 0; i < AUDIO_BLOCK; ++i) {
+            size_t j = (size_t)pos;
+            size_t k = j + 1 == frames ? 0 : j + 1;
+            float a = read_frame(data, j, fmt), b = read_frame(data, k, fmt);
+            float x = a + (b - a) * (float)(pos - (double)j);
+            float g = g0 + (gain - g0) * (float)i / AUDIO_BLOCK;
+            acc[i] += (int32_t)(x * g * 32767.0f);
+            pos += step;
+            if (pos >= (double)frames) pos -= (double)frames;
+        }
+    }
+};
+
+enum MusicSlot : uint8_t { MUSIC_TITLE, MUSIC_BG, MUSIC_SLOTS };
+
+enum class AudioCmdKind : uint8_t { Play, Music };
+struct AudioCmd {
+    AudioCmdKind kind{AudioCmdKind::Play};
+    uint8_t clip{0};     // Play: the Sfx; Music: the MusicSlot
+    uint8_t gain{255};   // /255
+    uint16_t fade_ms{0}; // Music only
+};
+
+// Where mixed blocks go. Spawn is the fallback when no PCM player is around (stock
+// macOS): the audio thread hands each clip to afplay, still off the game loop.
+enum class SinkKind : uint8_t { Null, WavFile, Pipe, Spawn };
+
+struct AudioSink {
+    SinkKind kind{SinkKind::Null};
+    FILE* f{nullptr};
+    uint64_t frames{0};
+
+    bool open_wav(const char* path) {
+        f = std::fopen(path, "wb");
+        if (!f) return false;
+        unsigned char hdr[44] = {};
+        std::fwrite(hdr, 1, sizeof hdr, f); // patched with real sizes in close()
+        kind = SinkKind::WavFile;
+        return true;
+    }
+    bool open_pipe(const char* cmd) {
+        f = ::popen(cmd, "w");
+        if (!f) return false;
+        std::setvbuf(f, nullptr, _IONBF, 0); // each mixer block goes out as it's mixed
+#ifdef F_SETPIPE_SZ
+        (void)fcntl(fileno(f), F_SETPIPE_SZ, 8192); // keep what sits in the pipe under ~90 ms
+#endif
+        kind = SinkKind::Pipe;
+        return true;
+    }
+    bool write(const int16_t* s, size_t n) {
+        frames += n;
+        if (kind != SinkKind::WavFile && kind != SinkKind::Pipe) return true;
+        return std::fwrite(s, sizeof(int16_t), n, f) == n; // host is little-endian on every target we build
+    }
+    void close() {
+        if (!f) return;
+        if (kind == SinkKind::WavFile) {
+            auto le = [](unsigned char* p, uint32_t v, int n) { for (int i = 0; i < n; ++i) p[i] = (unsigned char)(v >> (8 * i)); };
+            unsigned char h[44];
+            uint32_t data = (uint32_t)(frames * 2);
+            std::memcpy(h, "RIFF", 4); le(h + 4, 36 + data, 4); std::memcpy(h + 8, "WAVEfmt ", 8);
+            le(h + 16, 16, 4); le(h + 20, 1, 2); le(h + 22, 1, 2); le(h + 24, AUDIO_RATE, 4);
+            le(h + 28, AUDIO_RATE * 2, 4); le(h + 32, 2, 2); le(h + 34, 16, 2);
+            std::memcpy(h + 36, "data", 4); le(h + 40, data, 4);
+            std::fseek(f, 0, SEEK_SET);
+            std::fwrite(h, 1, sizeof h, f);
+            std::fclose(f);
+        } else {
+            ::pclose(f);
+        }
+        f = nullptr;
+    }
+};
+
+struct AudioStats {
+    uint64_t plays{0};
+    uint64_t cmds_dropped{0};
+    uint64_t blocks{0};
+    uint64_t late_blocks{0}; // mixer woke >100 ms late and resynced
+    int voices_peak{0};
+};
+
+struct AudioEngine {
+    std::array<Clip, (size_t)Sfx::Count> clips;
+    AudioSink sink;
+    SpscRing<AudioCmd, 256> cmds;
+    std::thread th;
+    std::atomic<bool> stop{false};
+    AudioStats stats; // written by the audio thread, read after join()
+
+    struct Voice { int clip{-1}; size_t pos{0}; int gain{0}; };
+    std::array<Voice, MAX_VOICES> voices{};
+    std::array<MusicStream, MUSIC_SLOTS> music{};
+
+    // Decode one clip; unreadable or unsupported files simply stay silent.
+    void load(Sfx id, const std::string& path) {
+        Clip& c = clips[(size_t)id];
+        c.path = path;
+        if (sink.kind == SinkKind::Spawn) {
+            c.loaded = file_exists(path.c_str());
+            return;
+        }
+        std::string bytes;
+        c.loaded = read_file(path.c_str(), bytes) && (decode_wav(bytes, c.owned) || decode_aiff(bytes, c.owned));
+        c.pcm = c.owned.data();
+        c.len = c.owned.size();
+    }
+
+    // Use PCM that is already in mixer format (the asset pack), without copying.
+    void attach(Sfx id, const unsigned char* pcm, size_t bytes, const std::string& path) {
+        Clip& c = clips[(size_t)id];
+        c.path = path;
+        c.pcm = (const int16_t*)pcm;
+        c.len = bytes / sizeof(int16_t);
+        c.loaded = true;
+    }
+
+    // Map a track; call before start(). Missing or non-WAV files leave the slot silent.
+    bool open_music(MusicSlot slot, const char* path) { return music[slot].open(path); }
+
+    // Fade a track to `volume` over fade_ms (0 = at once); from silence it restarts at
+    // the top. Returns false if the slot has no track.
+    bool set_music(MusicSlot slot, float volume, int fade_ms) {
+        if (!music[slot].ready()) return false;
+        AudioCmd c;
+        c.kind = AudioCmdKind::Music;
+        c.clip = slot;
+        c.gain = (uint8_t)std::lround(std::max(0.0f, std::min(1.0f, volume)) * 255);
+        c.fade_ms = (uint16_t)std::max(0, std::min(60000, fade_ms));
+        if (!cmds.push(c)) stats.cmds_dropped++;
+        return true;
+    }
+
+    void play(Sfx id, float gain = 1.0f) {
+        if (!clips[(size_t)id].loaded) return;
+        AudioCmd c;
+        c.clip = (uint8_t)id;
+        c.gain = (uint8_t)std::lround(std::max(0.0f, std::min(1.0f, gain)) * 255);
+        if (!cmds.push(c)) stats.cmds_dropped++; // only the producer touches this counter
+    }
+
+    void start() {
+        if (sink.kind == SinkKind::Pipe) signal(SIGPIPE, SIG_IGN); // a dead player must not kill the game
+        // The mixer inherits the mask it's created with: keep the loop's signals off it.
+        sigset_t set, old;
+        loop_signal_set(set);
+        pthread_sigmask(SIG_BLOCK, &set, &old);
+        th = std::thread([this] { run(); });
+        pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    }
+    void shutdown() {
+        if (th.joinable()) {
+            stop.store(true);
+            th.join();
+        }
+        for (MusicStream& m : music) {
+            if (m.pid > 0) { kill(m.pid, SIGTERM); waitpid(m.pid, nullptr, 0); m.pid = -1; }
+            m.close();
+        }
+        sink.close();
+    }
+
+    // posix_spawnp rather than fork+exec: this runs on the mixer thread of a threaded
+    // process. Children get an empty mask (the mixer's blocked set would survive exec)
+    // and default dispositions for the signals we block or ignore.
+    static pid_t spawn_afplay(const char* const* argv) {
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        sigset_t none, dflt;
+        sigemptyset(&none);
+        loop_signal_set(dflt);
+        sigaddset(&dflt, SIGPIPE);
+        posix_spawnattr_setsigmask(&attr, &none);
+        posix_spawnattr_setsigdefault(&attr, &dflt);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+        pid_t pid = -1;
+        if (posix_spawnp(&pid, "afplay", nullptr, &attr, const_cast<char* const*>(argv), environ) != 0) pid = -1;
+        posix_spawnattr_destroy(&attr);
+        return pid;
+    }
+
+    void spawn_clip(const Clip& c) {
+        const char* argv[] = { "afplay", c.path.c_str(), nullptr };
+        (void)spawn_afplay(argv);
+    }
+
+    void spawn_music(MusicStream& m) {
+        char vol[16];
+        std::snprintf(vol, sizeof vol, "%.2f", m.target);
+        const char* argv[] = { "afplay", "-v", vol, m.path, nullptr };
+        m.pid = spawn_afplay(argv);
+    }
+
+    void set_music_target(const AudioCmd& c) {
+        MusicStream& m = music[c.clip];
+        const float vol = c.gain / 255.0f;
+        if (!m.audible()) m.pos = 0;
+        m.target = vol;
+        m.ramp = c.fade_ms ? std::fabs(vol - m.gain) * 10.0f / c.fade_ms : 1.0f;
+        if (sink.kind != SinkKind::Spawn) return;
+        // afplay can neither fade nor loop: start/stop it, and respawn it when it ends.
+        m.gain = vol;
+        if (vol > 0 && m.pid < 0) spawn_music(m);
+        if (vol == 0 && m.pid > 0) kill(m.pid, SIGTERM);
+    }
+
+    void reap_children() {
+        pid_t pid;
+        while ((pid = waitpid(-1, nullptr, WNOHANG)) > 0) {
+            for (MusicStream& m : music) {
+                if (m.pid != pid) continue;
+                m.pid = -1;
+                if (m.target > 0) spawn_music(m);
+            }
+        }
+    }
+
+    void mix(int16_t* out) {
+        std::array<int32_t, AUDIO_BLOCK> acc{};
+        int active = 0;
+        for (Voice& v : voices) {
+            if (v.clip < 0) continue;
+            const Clip& clip = clips[(size_t)v.clip];
+            const int16_t* pcm = clip.pcm;
+            size_t n = std::min<size_t>(AUDIO_BLOCK, clip.len - v.pos);
+            for (size_t i = 0; i < n; ++i) acc[i] += (pcm[v.pos + i] * v.gain) >> 8;
+            v.pos += n;
+            if (v.pos >= clip.len) v.clip = -1;
+            else ++active;
+        }
+        for (MusicStream& m : music)
+            if (m.ready() && m.audible()) m.mix(acc.data());
+        stats.voices_peak = std::max(stats.voices_peak, active);
+        for (int i = 0; i < AUDIO_BLOCK; ++i) out[i] = (int16_t)std::max(-32768, std::min(32767, acc[(size_t)i]));
+    }
+
+    void start_voice(const AudioCmd& c) {
+        stats.plays++;
+        if (sink.kind == SinkKind::Spawn) { spawn_clip(clips[c.clip]); return; }
+        // A free slot, else steal the voice furthest along (closest to finishing).
+        Voice* slot = &voices[0];
+        for (Voice& v : voices) {
+            if (v.clip < 0) { slot = &v; break; }
+            if (v.pos > slot->pos) slot = &v;
+        }
+        *slot = Voice{ c.clip, 0, c.gain + 1 };
+    }
+
+    void run() {
+        using clk = std::chrono::steady_clock;
+        std::array<int16_t, AUDIO_BLOCK> block{};
+        for (int i = 0; i < AUDIO_LEAD_BLOCKS; ++i) sink.write(block.data(), block.size());
+        auto next = clk::now();
+        while (!stop.load(std::memory_order_relaxed)) {
+            AudioCmd c;
+            while (cmds.pop(c)) {
+                if (c.kind == AudioCmdKind::Music) set_music_target(c);
+                else start_voice(c);
+            }
+            if (sink.kind == SinkKind::Spawn) reap_children();
+            mix(block.data());
+            sink.write(block.data(), block.size());
+            stats.blocks++;
+            next += std::chrono::milliseconds(10);
+            auto now = clk::now();
+            if (now - next > std::chrono::milliseconds(100)) { next = now; stats.late_blocks++; }
+            std::this_thread::sleep_until(next);
+        }
+    }
+};
+
+// Set only by the interactive game; headless and batch sims leave it null (silent).
+static AudioEngine* g_audio = nullptr;
+
+// Title/background music live in the mixer, so these just move gain targets.
+static bool start_title_music() { return g_audio && g_audio->set_music(MUSIC_TITLE, 1.0f, 0); }
+static void stop_title_music(int fade_ms = 0) { if (g_audio) g_audio->set_music(MUSIC_TITLE, 0, fade_ms); }
+static void start_bg_music() { if (g_audio) g_audio->set_music(MUSIC_BG, BG_MUSIC_VOL, MUSIC_FADE_MS); }
+static void stop_bg_music() { if (g_audio) g_audio->set_music(MUSIC_BG, 0, 0); }
+
+static inline void queue_sfx(Sfx id) {
+    if (ENABLE_SOUNDS && g_audio) g_audio->play(id);
+}
+
+// Pick and open a sink. spec: "auto" (aplay on Linux, afplay per clip elsewhere),
+// "null", "aplay" or "wav:PATH".
+static bool open_audio_sink(AudioSink& sink, const char* spec) {
+    if (std::strcmp(spec, "null") == 0) return true;
+    if (std::strncmp(spec, "wav:", 4) == 0) return sink.open_wav(spec + 4);
+    char cmd[160];
+    // aplay's own buffer matches the mixer's lead (its default can hold ~500 ms)
+    const int period_us = (int)(AUDIO_BLOCK * 1000000LL / AUDIO_RATE);
+    std::snprintf(cmd, sizeof cmd, "aplay -q -t raw -f S16_LE -c 1 -r %d --period-time=%d --buffer-time=%d 2>/dev/null",
+                  AUDIO_RATE, period_us, period_us * (AUDIO_LEAD_BLOCKS + 1));
+    if (std::strcmp(spec, "aplay") == 0) return sink.open_pipe(cmd);
+#ifdef __linux__
+    if (have_cmd("aplay")) return sink.open_pipe(cmd);
+#else
+    if (have_cmd("afplay")) { sink.kind = SinkKind::Spawn; return true; }
+#endif
+    return true; // nothing to play through: stay on the null sink
+}
+
+// Load every sound the game can ask for (assets from the resolved registry).
+static void load_sound_bank(AudioEngine& a) {
+    for (size_t i = 0; i < (size_t)Sfx::Count; ++i) {
+        const SfxSource& src = SFX_SOURCES[i];
+        const unsigned char* p;
+        size_t n;
+        if (src.asset == Asset::Count)
+            a.load((Sfx)i, std::string("/System/Library/Sounds/") + src.system + ".aiff");
+        else if (a.sink.kind != SinkKind::Spawn && g_assets.blob(src.asset, PackForm::Pcm, p, n))
+            a.attach((Sfx)i, p, n, g_assets.path(src.asset));
+        else if (g_assets.has(src.asset))
+            a.load((Sfx)i, g_assets.path(src.asset));
+    }
+    for (auto [slot, asset] : { std::pair{ MUSIC_TITLE, Asset::TitleMusic }, std::pair{ MUSIC_BG, Asset::BgMusic } }) {
+        const unsigned char* p;
+        size_t n;
+        if (g_assets.blob(asset, PackForm::Raw, p, n)) a.music[slot].attach(p, n, g_assets.path(asset));
+        else if (g_assets.has(asset))                  a.open_music(slot, g_assets.path(asset));
+    }
+}
+
+static void dump_audio_stats(const AudioEngine& a) {
+    static const char* names[] = { "null", "wav", "pipe", "spawn" };
+    const AudioStats& s = a.stats;
+    size_t pcm = 0;
+    int loaded = 0;
+    for (const Clip& c : a.clips) { pcm += c.len * sizeof(int16_t); loaded += c.loaded; }
+    std::cerr << "[audio] sink=" << names[(int)a.sink.kind]
+              << " clips=" << loaded
+              << " pcm_kb=" << pcm / 1024
+              << " plays=" << s.plays
+              << " voices_peak=" << s.voices_peak
+              << " cmds_dropped=" << s.cmds_dropped
+              << " blocks=" << s.blocks
+              << " late=" << s.late_blocks << "\n";
+}
 
 // ---------- Splash ----------
-static constexpr const char* SPLASH_PATH = "assets/splash.png";
 static constexpr int SPLASH_SCALE_PCT = 40; // ~40% of terminal width
 
 static void ascii_splash_art() {
@@ -368,81 +1854,91 @@ static void ascii_splash_art() {
     std::cout << "\n";
 }
 
-static void cinematic_splash_and_wait() {
+static void cinematic_splash_and_wait(EventLoop& loop) {
     using namespace std::chrono;
 
     std::cout << "\x1b[2J\x1b[H\x1b[?25l" << std::flush;
+    refresh_term_size();
 
     // Title theme: if present, start it; otherwise do a quick built-in ping
-    if (file_exists(TITLE_MUSIC_WAV)) start_title_music();
-    else                              play_system_sound(SPLASH_SOUND);
-
-    bool showed_image = false;
+    if (!start_title_music()) queue_sfx(SPLASH_SOUND);
 
     int cols = term_cols();
     int img_cols = std::max(10, (cols * SPLASH_SCALE_PCT) / 100);
     int pad = std::max(0, (cols - img_cols) / 2);
 
-    if (!showed_image && is_iterm() && file_exists(SPLASH_PATH)) {
-        std::string data;
-        if (read_file(SPLASH_PATH, data)) {
-            center_line("\x1b[1m\x1b[92mTHE FIERCE POOPING SNAKE WHO EATS PIECES OF SHIT LIKE YOU FOR BREAKFAST!\x1b[0m");
-            std::cout << "\n";
-            for (int i = 0; i < pad; ++i) std::cout << ' ';
-            std::string b64 = b64_encode(data);
+    const char* splash_path = g_assets.path(Asset::Splash);
+    const bool have_splash = g_assets.has(Asset::Splash);
+
+    // Inline image through whichever protocol the terminal speaks (see TermCaps). The
+    // payload is pre-encoded in the asset pack, else the PNG is read + encoded now.
+    const unsigned char* b64 = nullptr;
+    size_t b64_len = 0;
+    std::string data, encoded;
+    if (have_splash && (g_caps.iterm_images || g_caps.kitty_images) &&
+        !g_assets.blob(Asset::Splash, PackForm::Base64, b64, b64_len) && read_file(splash_path, data)) {
+        encoded = b64_encode(data);
+        b64 = (const unsigned char*)encoded.data();
+        b64_len = encoded.size();
+    }
+    if (b64) {
+        center_line("\x1b[1m\x1b[92mTHE FIERCE POOPING SNAKE WHO EATS PIECES OF SHIT LIKE YOU FOR BREAKFAST!\x1b[0m");
+        std::cout << "\n";
+        put_spaces(pad);
+        if (g_caps.iterm_images) {
             std::string tok = std::to_string(std::time(nullptr));
             std::cout << "\x1b]1337;File=name=splash.png?" << tok
                       << ";inline=1;cache=0;width=" << img_cols
-                      << ";preserveAspectRatio=1:" << b64 << "\x07\n";
-            showed_image = true;
+                      << ";preserveAspectRatio=1:";
+            std::cout.write((const char*)b64, (std::streamsize)b64_len);
+            std::cout << "\x07\n";
+        } else {
+            // kitty: PNG (f=100) in 4 KiB chunks, sized by columns; q=2 keeps the
+            // terminal from answering on stdin, which would read as a keypress.
+            for (size_t off = 0; off < b64_len; off += 4096) {
+                size_t n = std::min<size_t>(4096, b64_len - off);
+                std::cout << "\x1b_G";
+                if (off == 0) std::cout << "a=T,f=100,q=2,c=" << img_cols << ",";
+                std::cout << "m=" << (off + n < b64_len) << ";";
+                std::cout.write((const char*)b64 + off, (std::streamsize)n);
+                std::cout << "\x1b\\";
+            }
+            std::cout << "\n";
         }
-    }
-
-    if (!showed_image && std::getenv("KITTY_WINDOW_ID") && have_cmd("kitty") && file_exists(SPLASH_PATH)) {
-        showed_image = true;
-        int w = img_cols;
-        int h = std::max(6,  (term_rows() * SPLASH_SCALE_PCT) / 100);
-        std::cout << "\x1b[2J\x1b[H";
-        std::string cmd = "kitty +kitten icat --align center --place "
-                        + std::to_string(w) + "x" + std::to_string(h) + "@0x0 '" + SPLASH_PATH + "'";
-        (void)std::system(cmd.c_str());
-        center_line("\x1b[1m\x1b[92mTHE FIERCE POOPING SNAKE\x1b[0m");
-        std::cout << "\n";
-    }
-
-    if (!showed_image && is_iterm() && have_cmd("imgcat") && file_exists(SPLASH_PATH)) {
-        showed_image = true;
+    } else {
         std::cout << "\x1b[2J\x1b[H";
-        for (int i = 0; i < pad; ++i) std::cout << ' ';
-        std::string cmd = "imgcat --width=" + std::to_string(img_cols) + " '" + SPLASH_PATH + "'";
-        (void)std::system(cmd.c_str());
-        center_line("\x1b[1m\x1b[92mTHE FIERCE POOPING SNAKE\x1b[0m");
-        std::cout << "\n";
+        ascii_splash_art();
     }
-
-    if (!showed_image) { std::cout << "\x1b[2J\x1b[H"; ascii_splash_art(); }
+    std::cout << std::flush; // show it now, not with the first prompt blink
 
     bool bright = true;
-    auto last = std::chrono::steady_clock::now();
+    loop.arm(steady_clock::now() + 400ms);
     while (true) {
-        if (auto k = read_key_now()) break;
-        auto now = std::chrono::steady_clock::now();
-        if (now - last >= 400ms) {
-            bright = !bright; last = now;
+        unsigned ev = loop.wait();
+        if (ev & EV_QUIT) break;
+        if (ev & EV_INPUT) {
+            unsigned char buf[64];
+            ssize_t n = read_input(buf, sizeof buf);
+            if (n <= 0 || drop_late_caps_reply(buf, (size_t)n) > 0) break; // any key (or a dead stdin) continues
+        }
+        if (ev & EV_TIMER) {
+            bright = !bright;
+            loop.arm(steady_clock::now() + 400ms);
             std::string msg = bright
                 ? std::string("\x1b[92m[ Press any key to continue ]\x1b[0m")
                 : std::string("\x1b[32m[ Press any key to continue ]\x1b[0m");
+            refresh_term_size();
             int w = term_cols();
             int pad2 = std::max(0, (int)(w - (int)msg.size()) / 2);
             std::cout << "\r";
-            for (int i = 0; i < pad2; ++i) std::cout << ' ';
+            put_spaces(pad2);
             std::cout << msg << std::flush;
         }
-        std::this_thread::sleep_for(50ms);
     }
+    loop.disarm();
 
-    // Leaving splash → stop the title theme now
-    stop_title_music();
+    // Leaving splash → fade the title theme out under the incoming background loop
+    stop_title_music(MUSIC_FADE_MS);
     std::cout << "\x1b[?25h\x1b[2J\x1b[H" << std::flush;
 }
 
@@ -450,37 +1946,295 @@ static void cinematic_splash_and_wait() {
 struct Point { int r, c; };
 enum class Dir { Up, Down, Left, Right };
 
+// Cells are packed as row*COLS+col in 16 bits.
+static constexpr int CELLS = ROWS * COLS;
+static_assert(CELLS <= 0xFFFF, "cell ids must fit in 16 bits");
+static inline uint16_t cell_id(Point p) { return (uint16_t)(p.r * COLS + p.c); }
+static inline Point cell_point(uint16_t id) { return Point{ id / COLS, id % COLS }; }
+
+// Wrapped neighbour of every cell in each Dir, so stepping never branches on the edges.
+struct NeighborTable {
+    std::array<std::array<uint16_t, 4>, CELLS> next{};
+    NeighborTable() {
+        for (int r = 0; r < ROWS; ++r) {
+            for (int c = 0; c < COLS; ++c) {
+                auto& n = next[(size_t)(r * COLS + c)];
+                n[(size_t)Dir::Up]    = cell_id({ (r + ROWS - 1) % ROWS, c });
+                n[(size_t)Dir::Down]  = cell_id({ (r + 1) % ROWS, c });
+                n[(size_t)Dir::Left]  = cell_id({ r, (c + COLS - 1) % COLS });
+                n[(size_t)Dir::Right] = cell_id({ r, (c + 1) % COLS });
+            }
+        }
+    }
+    uint16_t operator()(uint16_t id, Dir d) const { return next[id][(size_t)d]; }
+};
+static const NeighborTable NEIGHBOR;
+
+// Snake body: fixed-capacity power-of-two ring of packed cell ids. Index 0 is the head.
+struct SnakeBody {
+    static constexpr uint32_t CAP  = 2048;
+    static constexpr uint32_t MASK = CAP - 1;
+    static_assert(CAP >= (uint32_t)CELLS && (CAP & MASK) == 0, "ring must hold the whole board");
+
+    std::array<uint16_t, CAP> ring{};
+    uint32_t head{0}; // slot of the head
+    uint32_t len{0};
+
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    uint16_t front() const { return ring[head]; }
+    uint16_t back() const { return ring[(head + len - 1) & MASK]; }
+    uint16_t operator[](size_t i) const { return ring[(head + (uint32_t)i) & MASK]; }
+
+    void push_front(uint16_t id) { head = (head - 1) & MASK; ring[head] = id; ++len; }
+    void push_back(uint16_t id) { ring[(head + len) & MASK] = id; ++len; }
+    void pop_back() { --len; }
+    void clear() { head = 0; len = 0; }
+};
+
 enum class PoopState { Good, Bomb };
 struct Poop {
     Point p;
-    std::chrono::steady_clock::time_point activated_at;
+    uint32_t id{0};          // matches the timers scheduled for this poop
     PoopState state{PoopState::Good};
     bool expired_punished{false};
 };
 
+// Live poops/bombs: a dense, fixed-capacity pool (swap-remove keeps it packed) plus a
+// per-cell slot map, so lookup by cell, removal and iteration are all O(1) per item.
+// Storage never reallocates.
+struct PoopPool {
+    static constexpr uint16_t NONE = 0xFFFF;
+    std::array<Poop, CELLS> items{};
+    std::array<uint16_t, CELLS> slot_of;  // cell id → index into items, or NONE
+    int count{0};
+
+    PoopPool() { slot_of.fill(NONE); }
+
+    bool contains(uint16_t cell) const { return slot_of[cell] != NONE; }
+    Poop* find(uint16_t cell) { return contains(cell) ? &items[slot_of[cell]] : nullptr; }
+    const Poop* find(uint16_t cell) const { return contains(cell) ? &items[slot_of[cell]] : nullptr; }
+
+    // At most one poop per cell; returns false if the cell is already taken.
+    bool add(const Poop& pp) {
+        uint16_t cell = cell_id(pp.p);
+        if (contains(cell)) return false;
+        items[(size_t)count] = pp;
+        slot_of[cell] = (uint16_t)count++;
+        return true;
+    }
+    void remove(uint16_t cell) {
+        uint16_t i = slot_of[cell];
+        if (i == NONE) return;
+        const Poop& last = items[(size_t)--count];
+        items[i] = last;
+        slot_of[cell_id(last.p)] = i;
+        slot_of[cell] = NONE;
+    }
+    void clear() {
+        for (int i = 0; i < count; ++i) slot_of[cell_id(items[(size_t)i].p)] = NONE;
+        count = 0;
+    }
+
+    size_t size() const { return (size_t)count; }
+    bool empty() const { return count == 0; }
+    const Poop* begin() const { return items.data(); }
+    const Poop* end() const { return items.data() + count; }
+};
+
+// Inline, fixed-capacity vector for per-tick entity lists: never touches the heap.
+// push_back() refuses (returns false) when full.
+template <typename T, size_t N>
+struct FixedVec {
+    std::array<T, N> items{};
+    size_t count{0};
+
+    bool push_back(const T& v) {
+        if (count == N) return false;
+        items[count++] = v;
+        return true;
+    }
+    // Drop every element matching `pred`, keeping order.
+    template <typename Pred>
+    void erase_if(Pred pred) {
+        size_t out = 0;
+        for (size_t i = 0; i < count; ++i)
+            if (!pred(items[i])) items[out++] = items[i];
+        count = out;
+    }
+    void clear() { count = 0; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T* begin() { return items.data(); }
+    T* end() { return items.data() + count; }
+    const T* begin() const { return items.data(); }
+    const T* end() const { return items.data() + count; }
+};
+
 struct Explosion {
     Point center;
-    int frames_left{5};
-    std::vector<Point> ring;
+    uint32_t id{0};
+    uint64_t end_tick{0};   // removed by a BoomEnd timer at this tick
+    std::array<Point, 8> ring{};
+    int frames_left(uint64_t now) const { return end_tick > now ? (int)(end_tick - now) : 0; }
 };
 
 // Floating text particle: rises upward and fades
 struct FloatText {
-    std::string msg;
-    int row;            // current row in playfield (0..ROWS-1)
+    const char* msg;    // one of the static TAUNTS
+    int len;
+    int row;            // spawn row in playfield (0..ROWS-1)
     int col_start;      // starting column for msg (0..COLS-1)
-    int age{0};         // ticks since spawn
+    uint64_t born{0};   // tick it spawned on
     int life{20};       // total ticks to live (~2s at base speed)
     int step{3};        // rise one row every 'step' ticks
+    uint32_t id{0};
+    // Ages one tick in the tick it spawns, then rises every `step` ticks until the top row.
+    int row_at(uint64_t now) const {
+        int age = (int)(now - born) + 1;
+        return std::max(0, row - age / step);
+    }
+};
+
+// ---------- Tick scheduler ----------
+// Two-level hashed timer wheel keyed on the logical tick number: 256 one-tick slots,
+// then 64 slots of 256 ticks, then an overflow list. Events live in a fixed node pool
+// linked per slot, so scheduling never allocates and advancing one tick only touches
+// the events that are due (plus an amortised cascade every 256 ticks).
+enum class TimerKind : uint8_t { PoopArm, PoopExpire, BoomEnd, FloatEnd };
+
+struct TimerEvent {
+    uint64_t  due;
+    uint32_t  id;     // serial of the poop / explosion / float it belongs to
+    uint16_t  cell;   // poop cell (poop timers only)
+    TimerKind kind;
+    int32_t   next;   // intrusive list link (-1 = end)
+};
+
+struct TimerWheel {
+    static constexpr int L0_BITS = 8, L1_BITS = 6;
+    static constexpr uint64_t L0 = 1u << L0_BITS, L1 = 1u << L1_BITS;
+    static constexpr int CAPACITY = 2 * CELLS + 256;
+
+    std::array<TimerEvent, CAPACITY> nodes{};
+    std::array<int32_t, L0> l0;
+    std::array<int32_t, L1> l1;
+    int32_t overflow{-1};
+    int32_t free_head{-1};
+    int     live{0};
+    uint64_t now{0};
+
+    TimerWheel() {
+        l0.fill(-1);
+        l1.fill(-1);
+        for (int i = 0; i < CAPACITY; ++i) nodes[(size_t)i].next = (i + 1 < CAPACITY) ? i + 1 : -1;
+        free_head = 0;
+    }
+
+    // Due ticks in the past (or now) fire on the next advance().
+    bool schedule(uint64_t due, TimerKind kind, uint32_t id, uint16_t cell = 0) {
+        if (free_head < 0) return false;
+        int32_t n = free_head;
+        free_head = nodes[(size_t)n].next;
+        nodes[(size_t)n] = TimerEvent{ std::max(due, now + 1), id, cell, kind, -1 };
+        ++live;
+        place(n);
+        return true;
+    }
+
+    // Step to the next tick and hand every event due on it to fire(const TimerEvent&).
+    template <typename Fire>
+    void advance(Fire&& fire) {
+        ++now;
+        if ((now & (L0 * L1 - 1)) == 0) cascade(overflow);
+        if ((now & (L0 - 1)) == 0)      cascade(l1[(size_t)((now >> L0_BITS) & (L1 - 1))]);
+
+        int32_t n = l0[(size_t)(now & (L0 - 1))];
+        l0[(size_t)(now & (L0 - 1))] = -1;
+        while (n >= 0) {
+            int32_t next = nodes[(size_t)n].next;
+            TimerEvent ev = nodes[(size_t)n];
+            nodes[(size_t)n].next = free_head;
+            free_head = n;
+            --live;
+            fire(ev);
+            n = next;
+        }
+    }
+
+private:
+    void place(int32_t n) {
+        uint64_t due = nodes[(size_t)n].due;
+        int32_t* head;
+        if ((due >> L0_BITS) == (now >> L0_BITS))
+            head = &l0[(size_t)(due & (L0 - 1))];
+        else if ((due >> (L0_BITS + L1_BITS)) == (now >> (L0_BITS + L1_BITS)))
+            head = &l1[(size_t)((due >> L0_BITS) & (L1 - 1))];
+        else
+            head = &overflow;
+        nodes[(size_t)n].next = *head;
+        *head = n;
+    }
+    void cascade(int32_t& list) {
+        int32_t n = list;
+        list = -1;
+        while (n >= 0) {
+            int32_t next = nodes[(size_t)n].next;
+            place(n);
+            n = next;
+        }
+    }
+};
+
+// Set of free cells with O(1) insert/erase/contains and uniform random pick:
+// a dense array of cell indices plus a cell → slot map (swap-remove on erase).
+struct FreeCells {
+    static constexpr int N = ROWS * COLS;
+    static constexpr uint16_t NONE = 0xFFFF;
+    std::array<uint16_t, N> cells{};
+    std::array<uint16_t, N> slot{};
+    int count{0};
+
+    void fill_all() {
+        for (int i = 0; i < N; ++i) { cells[(size_t)i] = (uint16_t)i; slot[(size_t)i] = (uint16_t)i; }
+        count = N;
+    }
+    bool contains(size_t i) const { return slot[i] != NONE; }
+    void insert(size_t i) {
+        if (contains(i)) return;
+        cells[(size_t)count] = (uint16_t)i;
+        slot[i] = (uint16_t)count++;
+    }
+    void erase(size_t i) {
+        if (!contains(i)) return;
+        uint16_t s = slot[i];
+        uint16_t last = cells[(size_t)--count];
+        cells[s] = last;
+        slot[last] = s;
+        slot[i] = NONE;
+    }
+    template <typename Rng>
+    size_t pick(Rng& rng) const {
+        std::uniform_int_distribution<int> d(0, count - 1);
+        return cells[(size_t)d(rng)];
+    }
 };
 
 struct Game {
-    deque<Point> snake; // front=head
+    SnakeBody snake; // [0]=head; mutate only through push_head/push_tail/pop_tail
+    std::bitset<ROWS * COLS> occupied; // one bit per cell covered by the snake
+    FreeCells free_cells;              // cells with no snake, poop/bomb or food
     Dir dir = Dir::Right;
     Point food{0, 0};
+    bool food_on = false;   // off while poops/bombs leave no free cell; back once one frees
     bool game_over = false;
+    bool won = false;       // the snake covers the whole board
     int score = 0;
 
+    // Lifetime counters (batch summaries)
+    int bombs_detonated = 0;
+    int poops_eaten = 0;     // good poops only; disarmed bombs don't count
+
     // Bite animation (wide head while true)
     bool consuming = false;
     int chomp_frames = 0;
@@ -488,19 +2242,25 @@ struct Game {
 
     // Poop / Bombs
     int poop_to_drop = 0;
-    vector<Poop>  poops;
-    vector<Point> poop_seeds;
-    vector<Explosion> booms;
+    PoopPool      poops;
+    FixedVec<Point, 64>     poop_seeds;  // a drop that finds this full is skipped
+    FixedVec<Explosion, 32> booms;       // likewise for the blast visual (the penalty still applies)
+    static constexpr int BOOM_FRAMES = 5;
 
     // Floaters (NICE SHIT! / taunts)
-    vector<FloatText> floats;
+    FixedVec<FloatText, 1> floats;      // at most one taunt on screen
 
     int growth_pending = 0;    // queued growth (penalties)
     int level = 1;
-    int level_flash = 0;
+    // Logical clock + everything that happens "N ticks from now"
+    TimerWheel timers;
+    uint32_t next_serial = 1;
+    int tick_ms = BASE_TICK_MS; // current tick period; speed changes are applied in update()
+
+    uint64_t level_flash_until = 0;
     bool level_up_trigger = false;
 
-    int  reward_flash = 0;
+    uint64_t reward_flash_until = 0;
     bool slow_down_trigger = false;
     int  shrink_amount = 0;
 
@@ -516,75 +2276,139 @@ struct Game {
     // Round-robin index for poop-eating sound rotation
     int eat_poop_sound_idx = 0;
 
-    // Verified poop-eating clips (built at startup)
-    vector<const char*> eat_sfx;
+    // Verified poop-eating clips and the poop activation sound (picked at construction)
+    FixedVec<Sfx, 3> eat_sfx;
+    Sfx poop_sfx = FART_SOUND;
 
-    mt19937 rng{random_device{}()};
+    uint32_t seed;
+    mt19937 rng;
 
-    Game() {
+    // Everything random in a run derives from `seed_`, and time only advances through
+    // update(), so a seed plus an input sequence reproduces a game exactly.
+    explicit Game(uint32_t seed_) : seed(seed_), rng(seed_) {
+        free_cells.fill_all();
         int r = ROWS / 2, c = COLS / 2;
-        snake.push_back({r, c});
-        snake.push_back({r, c - 1});
-        snake.push_back({r, c - 2});
+        push_tail(cell_id({r, c}));
+        push_tail(cell_id({r, c - 1}));
+        push_tail(cell_id({r, c - 2}));
         place_food();
 
-        // Build the verified poop-eating sound pool once.
-        const char* candidates[] = { NOM_WAV, NASTY_WAV, GROSS_WAV };
-        for (const char* p : candidates) {
-            if (file_exists(p)) eat_sfx.push_back(p);
+        // Sound choices come from the asset registry, resolved once at startup.
+        for (Sfx s : { Sfx::Nom, Sfx::Nasty, Sfx::Gross }) {
+            if (g_assets.has(SFX_SOURCES[(size_t)s].asset)) eat_sfx.push_back(s);
         }
+        poop_sfx = g_assets.has(Asset::PoopWav) ? Sfx::Poop : FART_SOUND;
 
-        // Debug list of detected poop-eating sfx
-        if (eat_sfx.empty()) {
-            std::cerr << "[eat-poop sfx] none found in ./assets (falling back to system sound)\n";
+        // Debug list of detected poop-eating sfx (once per process; headless runs build many games)
+        static std::atomic<bool> sfx_logged{false};
+        if (sfx_logged.exchange(true)) {
+        } else if (eat_sfx.empty()) {
+            std::cerr << "[eat-poop sfx] none found in " << g_assets.root << " (falling back to system sound)\n";
         } else {
             std::cerr << "[eat-poop sfx] using:";
-            for (auto* p : eat_sfx) std::cerr << " " << p;
+            for (Sfx s : eat_sfx) std::cerr << " " << g_assets.path(SFX_SOURCES[(size_t)s].asset);
             std::cerr << "\n";
         }
 
-        // Seed rotation across the verified list
-        if (!eat_sfx.empty()) {
-            std::uniform_int_distribution<int> dist(0, (int)eat_sfx.size() - 1);
-            eat_poop_sound_idx = dist(rng);
-        } else {
-            eat_poop_sound_idx = 0;
-        }
+        // Seed rotation across the verified list. Always draw over all three candidates so
+        // the RNG stream (and so a seeded run) doesn't depend on which assets are installed.
+        std::uniform_int_distribution<int> dist(0, 2);
+        const int start = dist(rng);
+        eat_poop_sound_idx = eat_sfx.empty() ? 0 : start % (int)eat_sfx.size();
     }
 
     void on_player_input() { idle_ticks = 0; }
+
+    // Remaining flash ticks, derived from the scheduler clock.
+    int level_flash() const  { return level_flash_until  > timers.now ? (int)(level_flash_until  - timers.now) : 0; }
+    int reward_flash() const { return reward_flash_until > timers.now ? (int)(reward_flash_until - timers.now) : 0; }
+
+    // Wall-clock window → ticks at the current speed (rounded up).
+    uint64_t ticks_for(std::chrono::milliseconds d) const {
+        return (uint64_t)((d.count() + tick_ms - 1) / tick_ms);
+    }
     void refresh_idle_threshold() {
         idle_bloat_threshold = std::max(80, 120 - (level - 1) * 5);
     }
 
-    Point wrap(Point p) const {
-        if (p.r < 0) p.r = ROWS - 1;
-        if (p.r >= ROWS) p.r = 0;
-        if (p.c < 0) p.c = COLS - 1;
-        if (p.c >= COLS) p.c = 0;
-        return p;
+    Point head_point() const { return cell_point(snake.front()); }
+    uint16_t next_head(uint16_t head) const { return NEIGHBOR(head, dir); }
+
+    // ----- snake body + occupancy bitmap (kept in lockstep) -----
+    void push_head(uint16_t id) { snake.push_front(id); occupied.set(id); refresh_free(cell_point(id)); }
+    void push_tail(uint16_t id) { snake.push_back(id);  occupied.set(id); refresh_free(cell_point(id)); }
+    void pop_tail() {
+        uint16_t t = snake.back();
+        occupied.reset(t);
+        snake.pop_back();
+        refresh_free(cell_point(t));
+    }
+    void clear_snake() { snake.clear(); occupied.reset(); rebuild_free(); }
+
+    // A cell is free when nothing (snake, poop/bomb, food) sits on it.
+    bool cell_is_free(Point p) const {
+        return !occupied.test(cell_id(p)) && !poops.contains(cell_id(p)) && !(food_on && food.r == p.r && food.c == p.c);
     }
-    Point next_head(Point head) const {
-        switch (dir) {
-            case Dir::Up:    head.r--; break;
-            case Dir::Down:  head.r++; break;
-            case Dir::Left:  head.c--; break;
-            case Dir::Right: head.c++; break;
+    void refresh_free(Point p) {
+        if (cell_is_free(p)) free_cells.insert(cell_id(p));
+        else                 free_cells.erase(cell_id(p));
+    }
+    void rebuild_free() {
+        free_cells.fill_all();
+        for (int r = 0; r < ROWS; ++r)
+            for (int c = 0; c < COLS; ++c) refresh_free({r, c});
+    }
+
+    // Debug builds: the bitmap and free set must match the body/poops/food exactly.
+    void check_occupancy() const {
+        std::bitset<ROWS * COLS> expect;
+        for (size_t i = 0; i < snake.size(); ++i) expect.set(snake[i]);
+        if (expect != occupied || occupied.count() != snake.size()) {
+            std::cerr << "[debug] occupancy bitmap out of sync: bits=" << occupied.count()
+                      << " segments=" << snake.size() << "\n";
+            std::abort();
+        }
+        int free_expect = 0;
+        for (int r = 0; r < ROWS; ++r) {
+            for (int c = 0; c < COLS; ++c) {
+                bool f = cell_is_free({r, c});
+                free_expect += f;
+                if (f != free_cells.contains(cell_id({r, c}))) {
+                    std::cerr << "[debug] free-cell set out of sync at " << r << "," << c << "\n";
+                    std::abort();
+                }
+            }
+        }
+        if (free_expect != free_cells.count) {
+            std::cerr << "[debug] free-cell count " << free_cells.count << " != " << free_expect << "\n";
+            std::abort();
         }
-        return wrap(head);
     }
 
+    // One draw from the free set; a full board is a win rather than an endless retry loop.
     void place_food() {
-        uniform_int_distribution<int> R(0, ROWS - 1), C(0, COLS - 1);
-        while (true) {
-            Point p{R(rng), C(rng)};
-            bool on_snake = any_of(snake.begin(), snake.end(),
-                                   [&](const Point& s){ return s.r == p.r && s.c == p.c; });
-            if (!on_snake) { food = p; return; }
+        Point old = food;
+        if (free_cells.count == 0) {
+            // Nowhere new: food the snake didn't cover stays put, else it's hidden until
+            // a cell frees. Only the snake itself can fill the board for good; poops and
+            // bombs expire.
+            const uint16_t id = cell_id(old);
+            food_on = food_on && !occupied.test(id) && !poops.contains(id);
+            if (occupied.count() == (size_t)CELLS) {
+                won = true;
+                game_over = true;
+            }
+            return;
         }
+        size_t i = free_cells.pick(rng);
+        food = Point{(int)(i / COLS), (int)(i % COLS)};
+        food_on = true;
+        refresh_free(old);
+        refresh_free(food);
     }
 
-    void change_dir(char key) {
+    // Returns true if the direction actually changed.
+    bool change_dir(Key key) {
         auto opp = [&](Dir a, Dir b) {
             return (a == Dir::Up && b == Dir::Down) ||
                    (a == Dir::Down && b == Dir::Up) ||
@@ -592,168 +2416,168 @@ struct Game {
                    (a == Dir::Right && b == Dir::Left);
         };
         Dir ndir = dir;
-        if (key == 'W') ndir = Dir::Up;
-        else if (key == 'S') ndir = Dir::Down;
-        else if (key == 'A') ndir = Dir::Left;
-        else if (key == 'D') ndir = Dir::Right;
-        if (!opp(dir, ndir)) dir = ndir;
-    }
-
-    static vector<Point> explosion_ring(Point c) {
-        vector<Point> v = {
-            {c.r-1,c.c-1},{c.r-1,c.c},{c.r-1,c.c+1},
-            {c.r  ,c.c-1},           {c.r  ,c.c+1},
-            {c.r+1,c.c-1},{c.r+1,c.c},{c.r+1,c.c+1}
+        if (key == Key::Up) ndir = Dir::Up;
+        else if (key == Key::Down) ndir = Dir::Down;
+        else if (key == Key::Left) ndir = Dir::Left;
+        else if (key == Key::Right) ndir = Dir::Right;
+        if (ndir == dir || opp(dir, ndir)) return false;
+        dir = ndir;
+        return true;
+    }
+
+    static std::array<Point, 8> explosion_ring(Point c) {
+        const uint16_t mid = cell_id(c);
+        const uint16_t up = NEIGHBOR(mid, Dir::Up), down = NEIGHBOR(mid, Dir::Down);
+        const uint16_t ids[8] = {
+            NEIGHBOR(up, Dir::Left),   up,   NEIGHBOR(up, Dir::Right),
+            NEIGHBOR(mid, Dir::Left),        NEIGHBOR(mid, Dir::Right),
+            NEIGHBOR(down, Dir::Left), down, NEIGHBOR(down, Dir::Right)
         };
-        for (auto &p : v) {
-            if (p.r < 0) p.r += ROWS;
-            if (p.r >= ROWS) p.r -= ROWS;
-            if (p.c < 0) p.c += COLS;
-            if (p.c >= COLS) p.c -= COLS;
-        }
+        std::array<Point, 8> v;
+        for (size_t i = 0; i < 8; ++i) v[i] = cell_point(ids[i]);
         return v;
     }
 
     void trigger_bomb_expire(Point at) {
+        bombs_detonated++;
         growth_pending += BOMB_GROW_UNITS;
         speed_bump_trigger = true;
         speed_bump_amount  += BOMB_GROW_UNITS;
 
         Explosion e;
         e.center = at;
-        e.frames_left = 5;
+        e.id = next_serial++;
+        e.end_tick = timers.now + BOOM_FRAMES - 1; // the old countdown also decayed once on its spawn tick
         e.ring = explosion_ring(at);
-        booms.push_back(e);
+        if (booms.push_back(e)) timers.schedule(e.end_tick, TimerKind::BoomEnd, e.id);
 
-        queue_sys(BOMB_SOUND);
+        queue_sfx(BOMB_SOUND);
     }
 
-    void tick_poop_lifecycle() {
-        using clock = std::chrono::steady_clock;
-        const auto now = clock::now();
-
-        for (auto &pp : poops) {
-            auto age = now - pp.activated_at;
-            if (age >= GOOD_WINDOW && age < GOOD_WINDOW + BOMB_WINDOW) {
-                pp.state = PoopState::Bomb; // arm
-            }
-        }
-
-        // Expire → penalty
-        vector<Poop> remaining;
-        remaining.reserve(poops.size());
-        for (auto &pp : poops) {
-            auto age = now - pp.activated_at;
-            if (age >= GOOD_WINDOW + BOMB_WINDOW) {
-                if (!pp.expired_punished) {
-                    pp.expired_punished = true;
-                    trigger_bomb_expire(pp.p);
+    // Run every timer due this tick: poop arming/expiry, explosion and float lifetimes.
+    // A timer whose poop was eaten (or replaced) in the meantime no longer matches its id.
+    void run_timers() {
+        timers.advance([&](const TimerEvent& ev) {
+            switch (ev.kind) {
+            case TimerKind::PoopArm:
+                if (Poop* pp = poops.find(ev.cell); pp && pp->id == ev.id) pp->state = PoopState::Bomb;
+                break;
+            case TimerKind::PoopExpire:
+                if (Poop* pp = poops.find(ev.cell); pp && pp->id == ev.id) {
+                    Point at = pp->p;
+                    if (!pp->expired_punished) {
+                        pp->expired_punished = true;
+                        trigger_bomb_expire(at);
+                    }
+                    poops.remove(ev.cell);
+                    refresh_free(at);
                 }
-            } else {
-                remaining.push_back(pp);
+                break;
+            case TimerKind::BoomEnd:
+                booms.erase_if([&](const Explosion& e){ return e.id == ev.id; });
+                break;
+            case TimerKind::FloatEnd:
+                floats.erase_if([&](const FloatText& f){ return f.id == ev.id; });
+                break;
             }
-        }
-        poops.swap(remaining);
-    }
-
-    void decay_booms() {
-        for (auto &b : booms) b.frames_left--;
-        booms.erase(remove_if(booms.begin(), booms.end(),
-                              [](const Explosion& e){ return e.frames_left <= 0; }),
-                    booms.end());
-    }
-
-    void tick_float_texts() {
-        for (auto &ft : floats) {
-            ft.age++;
-            if (ft.age % ft.step == 0 && ft.row > 0) ft.row--;  // rise
-        }
-        floats.erase(remove_if(floats.begin(), floats.end(),
-                               [](const FloatText& f){ return f.age >= f.life || f.row < 0; }),
-                     floats.end());
-    }
-
-    bool cell_on_snake(int rr, int cc) const {
-        for (const auto& seg : snake) if (seg.r == rr && seg.c == cc) return true;
-        return false;
+        });
     }
 
-    bool find_poop_at(Point p, size_t* idx_out=nullptr) const {
-        for (size_t i = 0; i < poops.size(); ++i) {
-            if (poops[i].p.r == p.r && poops[i].p.c == p.c) {
-                if (idx_out) *idx_out = i;
-                return true;
-            }
-        }
-        return false;
-    }
+    bool cell_on_snake(uint16_t id) const { return occupied.test(id); }
+    bool cell_on_snake(int rr, int cc) const { return cell_on_snake(cell_id({rr, cc})); }
 
     void maybe_activate_poops() {
         if (poop_seeds.empty()) return;
-        vector<Point> remaining;
-        remaining.reserve(poop_seeds.size());
-        auto now = std::chrono::steady_clock::now();
+        const uint64_t now = timers.now;
+        const uint64_t good_ticks = ticks_for(GOOD_WINDOW);
+        const uint64_t bomb_ticks = ticks_for(BOMB_WINDOW);
 
         bool spawned_float_this_frame = false; // only one message per frame
 
-        for (const auto& s : poop_seeds) {
-            if (!cell_on_snake(s.r, s.c)) {
-                Poop pp; pp.p = s; pp.activated_at = now; pp.state = PoopState::Good; pp.expired_punished = false;
-                poops.push_back(pp);
-
-                // Poop activation sound (local wav preferred)
-                if (file_exists(POOP_WAV)) queue_wav(POOP_WAV);
-                else                       queue_sys(FART_SOUND);
-
-                // Floating taunt (at most one active)
-                if (floats.empty() && !spawned_float_this_frame) {
-                    std::uniform_int_distribution<int> pick(0, TAUNTS_COUNT - 1);
-                    std::string msg = TAUNTS[pick(rng)];
-                    int len = (int)msg.size();
-                    int c0 = std::max(0, std::min(COLS - len, s.c - len/2));
-                    floats.push_back(FloatText{msg, s.r, c0, 0, 20, 3});
-                    spawned_float_this_frame = true;
-                }
-            } else {
-                remaining.push_back(s);
+        // Seeds the tail has left are activated and dropped in place; the rest wait.
+        poop_seeds.erase_if([&](const Point& s) {
+            if (cell_on_snake(s.r, s.c)) return false;
+            Poop pp; pp.p = s; pp.id = next_serial++;
+            pp.state = PoopState::Good; pp.expired_punished = false;
+            if (poops.add(pp)) {
+                timers.schedule(now + good_ticks,              TimerKind::PoopArm,    pp.id, cell_id(s));
+                timers.schedule(now + good_ticks + bomb_ticks, TimerKind::PoopExpire, pp.id, cell_id(s));
             }
-        }
-        poop_seeds.swap(remaining);
+            refresh_free(s);
+
+            // Poop activation sound (local wav preferred)
+            queue_sfx(poop_sfx);
+
+            // Floating taunt (at most one active)
+            if (floats.empty() && !spawned_float_this_frame) {
+                std::uniform_int_distribution<int> pick(0, TAUNTS_COUNT - 1);
+                const char* msg = TAUNTS[pick(rng)];
+                int len = (int)std::strlen(msg);
+                int c0 = std::max(0, std::min(COLS - len, s.c - len/2));
+                FloatText ft{msg, len, s.r, c0, now, 20, 3, next_serial++};
+                floats.push_back(ft);
+                timers.schedule(now + (uint64_t)ft.life - 1, TimerKind::FloatEnd, ft.id);
+                spawned_float_this_frame = true;
+            }
+            return true;
+        });
     }
 
     // Rotate through the verified eat_sfx list; fallback to a system sound if empty.
     void queue_next_eat_poop_wav() {
         if (!eat_sfx.empty()) {
-            const char* path = eat_sfx[eat_poop_sound_idx];
-            queue_wav(path);
+            queue_sfx(eat_sfx.items[(size_t)eat_poop_sound_idx]);
             eat_poop_sound_idx = (eat_poop_sound_idx + 1) % (int)eat_sfx.size();
         } else {
             // No local clips verified; use a system fallback but keep a stable experience.
-            queue_sys(REWARD_SOUND);
+            queue_sfx(REWARD_SOUND);
         }
     }
 
+    // One logical tick.
     void update() {
+        speed_bump_trigger = false;
+        speed_bump_amount  = 0;
+        step();
+        apply_speed_triggers();
+        if (DEBUG_CHECKS) check_occupancy();
+    }
+
+    // Fold this tick's speed triggers into tick_ms.
+    void apply_speed_triggers() {
+        // Priority: reward slow-down overrides bumps this tick
+        if (slow_down_trigger) {
+            slow_down_trigger = false;
+            tick_ms = BASE_TICK_MS;
+            speed_bump_trigger = false;
+            speed_bump_amount  = 0;
+            return;
+        }
+        if (level_up_trigger) {
+            level_up_trigger = false;
+            tick_ms = std::max(MIN_TICK_MS, tick_ms - TICK_DECR_MS);
+        }
+        if (speed_bump_trigger && speed_bump_amount > 0) {
+            tick_ms = std::max(MIN_TICK_MS, tick_ms - GROW_DECR_MS * speed_bump_amount);
+        }
+    }
+
+    void step() {
         if (game_over) return;
 
-        tick_poop_lifecycle();
+        run_timers();
         maybe_activate_poops();
-        decay_booms();
-        tick_float_texts();
-
-        if (level_flash  > 0) level_flash--;
-        if (reward_flash > 0) reward_flash--;
+        if (!food_on && free_cells.count > 0) place_food();
 
         idle_ticks++;
 
         if (consuming) {
             if (--chomp_frames <= 0) {
-                Point nh = next_head(snake.front());
-                if (any_of(snake.begin(), snake.end(),
-                           [&](const Point& p){ return p.r == nh.r && p.c == nh.c; })) {
+                uint16_t nh = next_head(snake.front());
+                if (cell_on_snake(nh)) {
                     game_over = true; return;
                 }
-                snake.push_front(nh); // grow on food
+                push_head(nh); // grow on food
                 score += 10;
 
                 speed_bump_trigger = true;
@@ -761,16 +2585,16 @@ struct Game {
 
                 if (score % 100 == 0) {
                     level++;
-                    level_flash = 12;
+                    level_flash_until = timers.now + 12;
                     level_up_trigger = true;
-                    queue_sys(LEVEL_SOUND);
+                    queue_sfx(LEVEL_SOUND);
                     refresh_idle_threshold();
                 }
 
                 // bite SFX for eating food (queued)
                 {
                     std::uniform_int_distribution<int> dist(0, (int)(sizeof(BITE_SOUNDS)/sizeof(BITE_SOUNDS[0])) - 1);
-                    queue_sys(BITE_SOUNDS[dist(rng)]);
+                    queue_sfx(BITE_SOUNDS[dist(rng)]);
                 }
 
                 poop_to_drop = 3;
@@ -782,38 +2606,39 @@ struct Game {
             return;
         }
 
-        Point nh = next_head(snake.front());
+        const uint16_t nh = next_head(snake.front());
 
         // start chomp
-        if (nh.r == food.r && nh.c == food.c) {
+        if (food_on && nh == cell_id(food)) {
             consuming = true;
             chomp_frames = CHOMP_TOTAL;
             return;
         }
 
         // Poop/Bomb at next head cell?
-        size_t poop_idx = 0;
-        bool on_poop = find_poop_at(nh, &poop_idx);
+        const Poop* poop_here = poops.find(nh);
+        bool on_poop = poop_here != nullptr;
+        PoopState poop_state = on_poop ? poop_here->state : PoopState::Good;
 
         // Self-collision
-        if (any_of(snake.begin(), snake.end(),
-                   [&](const Point& p){ return p.r == nh.r && p.c == nh.c; })) {
+        if (cell_on_snake(nh)) {
             game_over = true; return;
         }
 
         // Move head
-        Point tail_before = snake.back();
-        snake.push_front(nh);
+        Point tail_before = cell_point(snake.back());
+        push_head(nh);
 
         bool grew_this_tick = false;
 
         if (on_poop) {
-            PoopState st = poops[poop_idx].state;
-            poops.erase(poops.begin() + (long)poop_idx);
+            PoopState st = poop_state;
+            poops.remove(nh);
 
             if (st == PoopState::Good) {
                 // EAT GOOD POOP → slow to base, shrink up to 2
                 grew_this_tick = true;
+                poops_eaten++;
                 slow_down_trigger = true;
 
                 int safe_min = 3;
@@ -821,9 +2646,9 @@ struct Game {
                 int can_remove = std::max(0, (int)snake.size() - safe_min);
                 int to_remove = std::min(desired, can_remove);
                 shrink_amount = to_remove;
-                while (to_remove-- > 0 && !snake.empty()) snake.pop_back();
+                while (to_remove-- > 0 && !snake.empty()) pop_tail();
 
-                reward_flash = 10;
+                reward_flash_until = timers.now + 10;
 
                 // Only on the FINAL good pellet of the current group → play one of the rotating WAVs
                 if (good_poops_left_in_group > 0) {
@@ -834,7 +2659,7 @@ struct Game {
                 }
             } else {
                 // Bomb eaten → neutralize (no group progress, no nom)
-                queue_sys(DISARM_SOUND);
+                queue_sfx(DISARM_SOUND);
             }
         } else if (growth_pending > 0) {
             grew_this_tick = true;
@@ -849,7 +2674,7 @@ struct Game {
         }
 
         if (!grew_this_tick) {
-            snake.pop_back();
+            pop_tail();
         }
 
         // queue poop seed
@@ -859,234 +2684,838 @@ struct Game {
         }
     }
 
-    bool cell_has_good_or_bomb(int rr, int cc, PoopState* st_out=nullptr) const {
-        for (const auto& p : poops) {
-            if (p.p.r == rr && p.p.c == cc) {
-                if (st_out) *st_out = p.state;
-                return true;
+    // Compose the whole frame into scr.back; present() decides what actually goes out.
+    // The playfield is built layer by layer, highest priority first; a cell keeps the
+    // first layer that claims it. Cost is O(cells + entities), independent of snake length.
+    // frame_ms is the presentation timestamp (only used for purely cosmetic blinking).
+    void render(Screen& scr, uint64_t frame_ms) const {
+        // Compose at the terminal's width: on a narrow terminal the box is clipped, since
+        // rows that wrapped would throw off present()'s cursor tracking.
+        int box_width = COLS + 2;
+        scr.resize(std::max(1, term_cols()), term_rows());
+        scr.clear();
+        int pad = std::max(0, (scr.width - box_width) / 2);
+
+        // centered status
+        {
+            char status[128];
+            int n = std::snprintf(status, sizeof status, "Score: %d   Level: %d%s%s",
+                                  score, level,
+                                  consuming           ? "   (CHOMP!)"      : "",
+                                  !poop_seeds.empty() ? "   (Dropping...)" : "");
+            if (growth_pending > 0)
+                n += std::snprintf(status + n, sizeof status - (size_t)n, "   (Penalty growth +%d)", growth_pending);
+            char reward[64] = "";
+            if (reward_flash() > 0) {
+                if (shrink_amount > 0) std::snprintf(reward, sizeof reward, "   (Time slowed!  Length -%d)", shrink_amount);
+                else                   std::snprintf(reward, sizeof reward, "   (Time slowed!)");
             }
+            int c0 = std::max(0, (scr.width - (int)(std::strlen(status) + std::strlen(reward))) / 2);
+            int c1 = scr.text(0, c0, status, Style{});
+            scr.text(0, c1, reward, Style{C_BRIGHT_YELLOW, C_DEFAULT, 0});
+        }
+
+        // top border
+        scr.put(1, pad, '+', Style{});
+        for (int c = 0; c < COLS; ++c) scr.put(1, pad + 1 + c, '-', Style{});
+        scr.put(1, pad + COLS + 1, '+', Style{});
+
+        // playfield background + side borders
+        const int lf = level_flash();
+        bool invert = (lf > 0 && ((lf / 2) % 2) == 0);
+        const Style field{C_WHITE, C_BLUE, (uint8_t)(invert ? A_REVERSE : 0)};
+        auto with_fg = [&](uint16_t fg) { Style st = field; st.fg = fg; return st; };
+
+        for (int r = 0; r < ROWS; ++r) {
+            scr.put(r + 2, pad, '|', Style{});
+            for (int c = 0; c < COLS; ++c) scr.put(r + 2, pad + 1 + c, ' ', field);
+            scr.put(r + 2, pad + COLS + 1, '|', Style{});
         }
-        return false;
-    }
 
-    // Check if a floating text overlays this cell; if yes, print its character and return true.
-    bool draw_float_at(int rr, int cc) const {
+        std::array<bool, ROWS * COLS> taken{};
+        auto stamp = [&](int r, int c, const char* glyph, uint16_t fg) {
+            bool& t = taken[(size_t)r * COLS + c];
+            if (t) return;
+            t = true;
+            scr.put(r + 2, pad + 1 + c, glyph, with_fg(fg));
+        };
+
+        // 1) Floating text overlays everything
         for (const auto& ft : floats) {
-            if (rr != ft.row) continue;
-            int len = (int)ft.msg.size();
-            if (cc >= ft.col_start && cc < ft.col_start + len) {
-                char ch = ft.msg[cc - ft.col_start];
-                std::cout << FG_BRIGHT_YELLOW << ch << FG_WHITE;
-                return true;
+            const int row = ft.row_at(timers.now);
+            if (row < 0 || row >= ROWS) continue;
+            for (int i = 0; i < ft.len; ++i) {
+                int c = ft.col_start + i;
+                if (c < 0 || c >= COLS) continue;
+                char g[2] = { ft.msg[i], 0 };
+                stamp(row, c, g, C_BRIGHT_YELLOW);
             }
         }
-        return false;
+
+        // 2) Explosions
+        for (const auto& b : booms) {
+            stamp(b.center.r, b.center.c, "✹", C_ORANGE);
+            const bool odd = (b.frames_left(timers.now) % 2) != 0;
+            for (const auto& p : b.ring) {
+                stamp(p.r, p.c, odd ? "+" : "×", odd ? C_BRIGHT_RED : C_YELLOW);
+            }
+        }
+
+        // 3) Big head (double-width emoji) covers the cell to its right too
+        Point head = head_point();
+        bool show_wide_head = consuming && head.c < COLS - 1; // avoid overflow at far right
+        if (show_wide_head && !taken[(size_t)head.r * COLS + head.c]) {
+            taken[(size_t)head.r * COLS + head.c] = true;
+            taken[(size_t)head.r * COLS + head.c + 1] = true;
+            scr.put_wide(head.r + 2, pad + 1 + head.c, WIDE_HEAD.c_str(), field);
+        }
+
+        // 4) Food
+        if (food_on) stamp(food.r, food.c, "●", C_BRIGHT_YELLOW);
+
+        // 5) Head (normal) and 6) body
+        for (size_t i = 0; i < snake.size(); ++i) {
+            Point seg = cell_point(snake[i]);
+            stamp(seg.r, seg.c, "●", C_BRIGHT_GREEN);
+        }
+
+        // 7) Poop / Bomb
+        bool flash = ((frame_ms / 240) % 2) == 0;
+        for (const auto& pp : poops) {
+            if (pp.state == PoopState::Good) stamp(pp.p.r, pp.p.c, "●", C_BROWN);
+            else                             stamp(pp.p.r, pp.p.c, "✹", flash ? C_BRIGHT_RED : C_ORANGE);
+        }
+
+        // bottom border
+        scr.put(ROWS + 2, pad, '+', Style{});
+        for (int c = 0; c < COLS; ++c) scr.put(ROWS + 2, pad + 1 + c, '-', Style{});
+        scr.put(ROWS + 2, pad + COLS + 1, '+', Style{});
+
+        int line = ROWS + 3;
+        scr.center(line++, "W/A/S/D to move, Q to quit.");
+        if (won)            scr.center(line++, "You filled the board. You win! Press Q to exit.");
+        else if (game_over) scr.center(line++, "Game Over. Press Q to exit.");
+        if (lf > 0) scr.center(line++, "LEVEL UP!  Speed increased", Style{C_BRIGHT_YELLOW, C_DEFAULT, A_BOLD});
     }
+};
 
-    void render() const {
-        int box_width = COLS + 2;
-        int pad = std::max(0, (term_cols() - box_width) / 2);
+// ---------- Frame timing & input latency (--stats) ----------
+// Log-linear histogram of nanosecond samples: 8 sub-buckets per power of two (~12% error).
+struct Histogram {
+    std::array<uint32_t, 512> counts{};
+    uint64_t n{0};
+    uint64_t max{0};
+
+    static int bucket(uint64_t v) {
+        if (v < 8) return (int)v;
+        int e = 63 - __builtin_clzll(v);
+        return (e - 2) * 8 + (int)((v >> (e - 3)) & 7);
+    }
+    static uint64_t bucket_floor(int b) {
+        if (b < 8) return (uint64_t)b;
+        int e = b / 8 + 2;
+        return (uint64_t)(8 + b % 8) << (e - 3);
+    }
+    void record(uint64_t v) { counts[(size_t)bucket(v)]++; n++; max = std::max(max, v); }
+    uint64_t percentile(double p) const {
+        if (!n) return 0;
+        uint64_t want = (uint64_t)std::ceil(p * (double)n), seen = 0;
+        for (int b = 0; b < (int)counts.size(); ++b) {
+            seen += counts[(size_t)b];
+            if (seen >= want) return std::min(max, bucket_floor(b + 1) - 1);
+        }
+        return max;
+    }
+};
 
-        std::cout << "\x1b[2J\x1b[H";
+struct FrameTiming {
+    bool enabled{false};
+    Histogram key_to_photon; // key read from stdin → frame containing its effect written
+    Histogram update;        // Game::update()
+    Histogram render;        // compose + diff/encode
+    Histogram write;         // write() of the frame
+    Histogram tick_period;   // actual time between tick starts
+    int tick_ms{0};          // period the speed logic asked for, as of the last tick
+    bool key_pending{false};
+    std::chrono::steady_clock::time_point key_t{};
+    std::chrono::steady_clock::time_point last_tick{};
+    char hud[160]{};
+};
+static FrameTiming g_timing;
 
-        // centered status
-        {
-            std::string status = "Score: " + std::to_string(score) + "   Level: " + std::to_string(level);
-            if (consuming)           status += "   (CHOMP!)";
-            if (!poop_seeds.empty()) status += "   (Dropping...)";
-            if (growth_pending > 0)  status += "   (Penalty growth +" + std::to_string(growth_pending) + ")";
-            if (reward_flash > 0) {
-                status += "   \x1b[93m(Time slowed!";
-                if (shrink_amount > 0) status += "  Length -" + std::to_string(shrink_amount);
-                status += ")\x1b[0m";
+static uint64_t ns_between(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+    return (uint64_t)std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(b - a).count());
+}
+
+// "850ns", "12.3us", "4.56ms"
+static const char* fmt_ns(char* buf, size_t n, uint64_t ns) {
+    if (ns < 1000)         std::snprintf(buf, n, "%lluns", (unsigned long long)ns);
+    else if (ns < 1000000) std::snprintf(buf, n, "%.1fus", ns / 1e3);
+    else                   std::snprintf(buf, n, "%.2fms", ns / 1e6);
+    return buf;
+}
+
+static void refresh_hud() {
+    const FrameTiming& t = g_timing;
+    char a[16], b[16], c[16], d[16], u[16], r[16], w[16], p[16];
+    std::snprintf(g_timing.hud, sizeof g_timing.hud,
+                  "key->photon p50 %s p95 %s p99 %s max %s | upd %s rnd %s wr %s | tick %dms act %s",
+                  fmt_ns(a, sizeof a, t.key_to_photon.percentile(0.50)),
+                  fmt_ns(b, sizeof b, t.key_to_photon.percentile(0.95)),
+                  fmt_ns(c, sizeof c, t.key_to_photon.percentile(0.99)),
+                  fmt_ns(d, sizeof d, t.key_to_photon.max),
+                  fmt_ns(u, sizeof u, t.update.percentile(0.50)),
+                  fmt_ns(r, sizeof r, t.render.percentile(0.50)),
+                  fmt_ns(w, sizeof w, t.write.percentile(0.50)),
+                  t.tick_ms,
+                  fmt_ns(p, sizeof p, t.tick_period.percentile(0.50)));
+}
+
+static void dump_timing_stats() {
+    if (!g_timing.enabled) return;
+    auto row = [](const char* name, const Histogram& h) {
+        char a[16], b[16], c[16], d[16];
+        std::cerr << "[timing] " << name << " n=" << h.n
+                  << " p50=" << fmt_ns(a, sizeof a, h.percentile(0.50))
+                  << " p95=" << fmt_ns(b, sizeof b, h.percentile(0.95))
+                  << " p99=" << fmt_ns(c, sizeof c, h.percentile(0.99))
+                  << " max=" << fmt_ns(d, sizeof d, h.max) << "\n";
+    };
+    row("key_to_photon", g_timing.key_to_photon);
+    row("update       ", g_timing.update);
+    row("render       ", g_timing.render);
+    row("write        ", g_timing.write);
+    row("tick_period  ", g_timing.tick_period);
+    std::cerr << "[timing] requested tick_ms=" << g_timing.tick_ms << "\n";
+}
+
+// Feed the tick every key that arrived before its deadline, stopping after the
+// first one that turns the snake; later turns stay queued for the following ticks.
+static void consume_input(Game& game, std::chrono::steady_clock::time_point deadline) {
+    KeyEvent e;
+    while (in_ring.peek(e) && e.t <= deadline) {
+        in_ring.drop_front();
+        game.on_player_input();
+        if (g_timing.enabled && !g_timing.key_pending) {
+            g_timing.key_pending = true;
+            g_timing.key_t = e.t;
+        }
+        if (game.change_dir(e.key)) break;
+    }
+}
+
+// Run one Game::update(), timing it (and the tick period) when --stats is on.
+static void timed_update(Game& game) {
+    if (!g_timing.enabled) { game.update(); return; }
+    auto t0 = std::chrono::steady_clock::now();
+    if (g_timing.last_tick.time_since_epoch().count()) g_timing.tick_period.record(ns_between(g_timing.last_tick, t0));
+    g_timing.last_tick = t0;
+    game.update();
+    g_timing.update.record(ns_between(t0, std::chrono::steady_clock::now()));
+}
+
+// Compose, diff and write one frame.
+static void draw_frame(const Game& game, Screen& scr, FrameBuf& out, bool paused) {
+    refresh_term_size(); // a new size makes render() resize the Screen → one full repaint
+    const uint64_t frame_ms = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+                                  std::chrono::steady_clock::now().time_since_epoch()).count();
+    auto compose = [&] {
+        game.render(scr, frame_ms);
+        if (paused) scr.center(2 + ROWS / 2, " PAUSED - press any key ", Style{C_BRIGHT_YELLOW, C_DEFAULT, A_REVERSE});
+    };
+    if (!g_timing.enabled) {
+        compose();
+        present(scr, out);
+        if (out.len == 0) return;
+        g_render_stats.writes++;
+        out.flush(STDOUT_FILENO);
+        return;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    compose();
+    scr.center(HUD_LINE, g_timing.hud, Style{C_GREEN, C_DEFAULT, 0});
+    present(scr, out);
+    auto t1 = std::chrono::steady_clock::now();
+    if (out.len) { g_render_stats.writes++; out.flush(STDOUT_FILENO); }
+    auto t2 = std::chrono::steady_clock::now();
+
+    g_timing.render.record(ns_between(t0, t1));
+    g_timing.write.record(ns_between(t1, t2));
+    if (g_timing.key_pending) {
+        g_timing.key_pending = false;
+        g_timing.key_to_photon.record(ns_between(g_timing.key_t, t2));
+    }
+    refresh_hud(); // shown on the next frame
+}
+
+// ---------- Render benchmark (--bench-render) ----------
+// Lays the snake out as a serpentine from the top-left corner, sprinkles poops after it,
+// and times compose (render) and diff/encode (present) for a few snake lengths.
+static void bench_layout(Game& g, int len) {
+    std::vector<Point> path;
+    for (int r = 0; r < ROWS; ++r)
+        for (int i = 0; i < COLS; ++i) path.push_back({r, (r % 2) ? COLS - 1 - i : i});
+    g.clear_snake();
+    for (int i = len - 1; i >= 0; --i) g.push_tail(cell_id(path[(size_t)i]));
+    g.poops.clear();
+    for (int i = len; i < (int)path.size() && (int)g.poops.size() < 24; i += 3) {
+        Poop pp; pp.p = path[(size_t)i];
+        pp.state = (g.poops.size() % 2) ? PoopState::Bomb : PoopState::Good;
+        g.poops.add(pp);
+    }
+    g.rebuild_free();
+    g.place_food();
+}
+
+static int run_render_bench() {
+    using clk = std::chrono::steady_clock;
+    constexpr int ITERS = 5000;
+    std::printf("%8s %14s %14s %12s\n", "length", "compose_us", "present_us", "bytes/frame");
+    for (int len : { 3, 500, 1500 }) {
+        Game g(1);
+        bench_layout(g, len);
+        Screen scr;
+        FrameBuf out;
+        for (int i = 0; i < 100; ++i) { g.render(scr, 0); present(scr, out); }
+
+        uint64_t bytes = 0;
+        clk::duration compose{}, encode{};
+        for (int i = 0; i < ITERS; ++i) {
+            g.consuming = (i % 2) == 0; // toggle the wide head so every frame has some damage
+            auto t0 = clk::now();
+            g.render(scr, (uint64_t)i * BASE_TICK_MS);
+            auto t1 = clk::now();
+            present(scr, out);
+            auto t2 = clk::now();
+            compose += t1 - t0;
+            encode  += t2 - t1;
+            bytes   += out.len;
+        }
+        auto us = [](clk::duration d) {
+            return std::chrono::duration<double, std::micro>(d).count() / ITERS;
+        };
+        std::printf("%8d %14.2f %14.2f %12llu\n", len, us(compose), us(encode),
+                    (unsigned long long)(bytes / ITERS));
+    }
+    return 0;
+}
+
+// ---------- Headless simulation (--headless) ----------
+// Drives Game::update() flat out: no terminal, no sound (g_audio is null, so
+// queue_sfx() drops everything), no sleeping. Input comes from a script or a seeded greedy/random policy.
+
+// Script lines are "<tick> <U|D|L|R>", ascending by tick; '#' starts a comment.
+struct ScriptStep { uint64_t tick; Key key; };
+
+static bool load_script(const char* path, vector<ScriptStep>& out) {
+    FILE* f = std::fopen(path, "r");
+    if (!f) return false;
+    char line[128];
+    while (std::fgets(line, sizeof line, f)) {
+        unsigned long long t; char k;
+        if (line[0] == '#' || std::sscanf(line, "%llu %c", &t, &k) != 2) continue;
+        Key key;
+        switch (k) {
+            case 'U': case 'u': key = Key::Up;    break;
+            case 'D': case 'd': key = Key::Down;  break;
+            case 'L': case 'l': key = Key::Left;  break;
+            case 'R': case 'r': key = Key::Right; break;
+            default: continue;
+        }
+        out.push_back({ (uint64_t)t, key });
+    }
+    std::fclose(f);
+    return true;
+}
+
+// Mostly steer at the food, sometimes mash a random key, then refuse a turn that
+// would bite the body if any other direction is clear.
+static void policy_step(Game& g, mt19937& rng) {
+    uint32_t roll = rng() % 10;
+    if (roll >= 8) return; // no key this tick
+    Key k;
+    Point h = g.head_point();
+    if (roll < 6) {
+        if      (g.food.r < h.r) k = Key::Up;
+        else if (g.food.r > h.r) k = Key::Down;
+        else if (g.food.c < h.c) k = Key::Left;
+        else                     k = Key::Right;
+    } else {
+        k = (Key)(rng() % 4);
+    }
+    g.on_player_input();
+    const Dir saved = g.dir;
+    g.change_dir(k);
+    if (!g.cell_on_snake(g.next_head(g.snake.front()))) return;
+    for (Key alt : { Key::Up, Key::Down, Key::Left, Key::Right }) {
+        g.dir = saved;
+        if (g.change_dir(alt) && !g.cell_on_snake(g.next_head(g.snake.front()))) return;
+    }
+    g.dir = saved;
+}
+
+struct SimResult {
+    uint32_t seed = 0;
+    uint64_t ticks = 0;
+    int score = 0, level = 0, length = 0;
+    int bombs = 0, poops_eaten = 0;
+    bool won = false;
+};
+
+// Play one game to the end (or max_ticks). A null script means the random policy.
+static SimResult run_sim(uint32_t seed, uint64_t max_ticks, const vector<ScriptStep>* script) {
+    Game g(seed);
+    g.refresh_idle_threshold();
+    mt19937 policy_rng(seed ^ 0x9E3779B9u);
+    size_t next_step = 0;
+    uint64_t t = 0;
+    while (t < max_ticks && !g.game_over) {
+        if (script) {
+            // same rule as consume_input(): the first turning key ends this tick's input
+            while (next_step < script->size() && (*script)[next_step].tick <= t) {
+                g.on_player_input();
+                if (g.change_dir((*script)[next_step++].key)) break;
             }
-            center_line(status);
+        } else {
+            policy_step(g, policy_rng);
         }
+        g.update();
+        ++t;
+    }
+    SimResult r;
+    r.seed = seed; r.ticks = t;
+    r.score = g.score; r.level = g.level; r.length = (int)g.snake.size(); r.won = g.won;
+    r.bombs = g.bombs_detonated; r.poops_eaten = g.poops_eaten;
+    return r;
+}
 
-        // top border
-        for (int i = 0; i < pad; ++i) cout << ' ';
-        cout << '+';
-        for (int c = 0; c < COLS; ++c) cout << '-';
-        cout << "+\n";
+// With a script: replay it once. Otherwise play seeded games back to back until
+// `budget` ticks have run, so long soaks survive the policy dying.
+static int run_headless(uint32_t seed, uint64_t budget, const char* script_path) {
+    vector<ScriptStep> script;
+    if (script_path && !load_script(script_path, script)) {
+        std::fprintf(stderr, "[headless] cannot read script %s\n", script_path);
+        return 1;
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t total = 0, games = 0;
+    int best = 0;
+    SimResult last;
+    do {
+        last = run_sim(seed + (uint32_t)games, budget - total, script_path ? &script : nullptr);
+        total += last.ticks;
+        ++games;
+        best = std::max(best, last.score);
+    } while (!script_path && total < budget);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::printf("[headless] seed=%u games=%llu ticks=%llu elapsed_ms=%.1f ticks/s=%.0f\n",
+                seed, (unsigned long long)games, (unsigned long long)total,
+                secs * 1e3, secs > 0 ? total / secs : 0.0);
+    std::printf("[headless] last game: seed=%u ticks=%llu score=%d level=%d length=%d%s best_score=%d\n",
+                last.seed, (unsigned long long)last.ticks, last.score, last.level, last.length,
+                last.won ? " (won)" : "", best);
+    return 0;
+}
 
-        // rows
-        Point head = snake.front();
-        bool show_wide_head = consuming && head.c < COLS - 1; // avoid overflow at far right
+// ---------- Batch runner (--batch N) ----------
+// N policy games with consecutive seeds spread over a work-stealing pool. Each
+// worker owns a [next, end) range of game indices packed into one atomic word:
+// the owner claims from the front, an idle worker steals the back half.
 
-        for (int r = 0; r < ROWS; ++r) {
-            for (int i = 0; i < pad; ++i) cout << ' ';
-            cout << '|';
-            bool invert = (level_flash > 0 && ((level_flash / 2) % 2) == 0);
-            if (invert) cout << "\x1b[7m";
-            cout << BG_BLUE << FG_WHITE;
+struct alignas(64) WorkRange {
+    std::atomic<uint64_t> span{0}; // next | end << 32
 
-            for (int c = 0; c < COLS; ++c) {
-                // 1) Floating text overlays everything
-                if (draw_float_at(r, c)) continue;
-
-                // 2) Explosions
-                bool drew_boom = false;
-                for (const auto &b : booms) {
-                    if ((r == b.center.r && c == b.center.c)) {
-                        cout << FG_ORANGE_208 << "✹" << FG_WHITE;
-                        drew_boom = true; break;
-                    }
-                    for (const auto &p : b.ring) {
-                        if (p.r == r && p.c == c) {
-                            cout << ((b.frames_left % 2) ? FG_RED : FG_YELLOW)
-                                 << ((b.frames_left % 2) ? "+" : "×") << FG_WHITE;
-                            drew_boom = true; break;
-                        }
-                    }
-                    if (drew_boom) break;
-                }
-                if (drew_boom) continue;
+    static uint64_t pack(uint32_t next, uint32_t end) { return (uint64_t)next | ((uint64_t)end << 32); }
 
-                // 3) Big head (double-width emoji)
-                if (show_wide_head && r == head.r && c == head.c) {
-                    std::cout << WIDE_HEAD;
-                    ++c; // skip next cell
-                    continue;
-                }
+    bool take(uint32_t& idx) {
+        uint64_t cur = span.load(std::memory_order_relaxed);
+        for (;;) {
+            uint32_t next = (uint32_t)cur, end = (uint32_t)(cur >> 32);
+            if (next >= end) return false;
+            if (span.compare_exchange_weak(cur, pack(next + 1, end), std::memory_order_acq_rel)) {
+                idx = next;
+                return true;
+            }
+        }
+    }
 
-                // 4) Food
-                if (food.r == r && food.c == c) {
-                    cout << FG_BRIGHT_YELLOW << "●" << FG_WHITE;
-                    continue;
-                }
+    // Split off the upper half of what's left; [lo, hi) is handed to the thief.
+    bool steal(uint32_t& lo, uint32_t& hi) {
+        uint64_t cur = span.load(std::memory_order_relaxed);
+        for (;;) {
+            uint32_t next = (uint32_t)cur, end = (uint32_t)(cur >> 32);
+            if (next >= end) return false;
+            uint32_t mid = next + (end - next) / 2; // a single left-over game goes whole
+            if (span.compare_exchange_weak(cur, pack(next, mid), std::memory_order_acq_rel)) {
+                lo = mid; hi = end;
+                return true;
+            }
+        }
+    }
+};
 
-                // 5) Head (normal)
-                if ((!show_wide_head || r != head.r || c != head.c) &&
-                    r == head.r && c == head.c) {
-                    cout << FG_BRIGHT_GREEN << "●" << FG_WHITE;
-                    continue;
-                }
+struct Dist { double mean; long min, p50, p90, p99, max; };
 
-                // 6) Body
-                bool on_body = false;
-                for (size_t i = 1; i < snake.size(); ++i) {
-                    if (snake[i].r == r && snake[i].c == c) { on_body = true; break; }
-                }
-                if (on_body) {
-                    cout << FG_BRIGHT_GREEN << "●" << FG_WHITE;
-                    continue;
-                }
+static Dist summarize(vector<long>& v) {
+    std::sort(v.begin(), v.end());
+    double sum = 0;
+    for (long x : v) sum += (double)x;
+    auto q = [&](double f) { return v[std::min(v.size() - 1, (size_t)(f * (double)v.size()))]; };
+    return { sum / (double)v.size(), v.front(), q(0.50), q(0.90), q(0.99), v.back() };
+}
 
-                // 7) Poop / Bomb
-                PoopState st;
-                if (cell_has_good_or_bomb(r, c, &st)) {
-                    if (st == PoopState::Good) {
-                        cout << FG_BROWN_256 << "●" << FG_WHITE;
-                    } else {
-                        bool flash = ((std::chrono::duration_cast<std::chrono::milliseconds>(
-                                      std::chrono::steady_clock::now().time_since_epoch()).count()/240) % 2) == 0;
-                        cout << (flash ? FG_RED : FG_ORANGE_208) << "✹" << FG_WHITE;
-                    }
-                } else {
-                    cout << ' ';
+static int run_batch(uint32_t seed, uint32_t games, unsigned threads, uint64_t max_ticks, bool json) {
+    if (games == 0) return 0;
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, games);
+
+    vector<SimResult> results(games);
+    vector<WorkRange> ranges(threads);
+    for (unsigned w = 0; w < threads; ++w) {
+        uint32_t lo = (uint32_t)((uint64_t)games * w / threads);
+        uint32_t hi = (uint32_t)((uint64_t)games * (w + 1) / threads);
+        ranges[w].span.store(WorkRange::pack(lo, hi));
+    }
+    std::atomic<uint64_t> steals{0};
+
+    auto worker = [&](unsigned self) {
+        mt19937 victim_rng(seed + self);
+        uint32_t idx;
+        for (;;) {
+            while (ranges[self].take(idx))
+                results[idx] = run_sim(seed + idx, max_ticks, nullptr);
+            // Out of work: try every other worker once, starting somewhere random.
+            bool got = false;
+            unsigned start = victim_rng() % threads;
+            for (unsigned k = 0; k < threads && !got; ++k) {
+                unsigned v = (start + k) % threads;
+                uint32_t lo, hi;
+                if (v != self && ranges[v].steal(lo, hi)) {
+                    // Our own range is empty and nobody steals from an empty range, so a plain store is safe.
+                    ranges[self].span.store(WorkRange::pack(lo, hi), std::memory_order_release);
+                    steals.fetch_add(1, std::memory_order_relaxed);
+                    got = true;
                 }
             }
+            if (!got) return;
+        }
+    };
+
+    auto t0 = std::chrono::steady_clock::now();
+    vector<std::thread> pool;
+    for (unsigned w = 1; w < threads; ++w) pool.emplace_back(worker, w);
+    worker(0);
+    for (auto& t : pool) t.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    uint64_t total_ticks = 0;
+    vector<long> score, level, ticks, bombs, poops;
+    for (const SimResult& r : results) {
+        total_ticks += r.ticks;
+        score.push_back(r.score);
+        level.push_back(r.level);
+        ticks.push_back((long)r.ticks);
+        bombs.push_back(r.bombs);
+        poops.push_back(r.poops_eaten);
+    }
+    const struct { const char* name; Dist d; } rows[] = {
+        { "score",          summarize(score) },
+        { "level",          summarize(level) },
+        { "survival_ticks", summarize(ticks) },
+        { "bombs",          summarize(bombs) },
+        { "poops_eaten",    summarize(poops) },
+    };
 
-            cout << RESET << "|\n";
+    if (json) {
+        std::printf("{\"seed\":%u,\"games\":%u,\"threads\":%u,\"metrics\":{", seed, games, threads);
+        bool first = true;
+        for (const auto& row : rows) {
+            std::printf("%s\"%s\":{\"mean\":%.3f,\"min\":%ld,\"p50\":%ld,\"p90\":%ld,\"p99\":%ld,\"max\":%ld}",
+                        first ? "" : ",", row.name, row.d.mean, row.d.min, row.d.p50, row.d.p90, row.d.p99, row.d.max);
+            first = false;
         }
+        std::printf("}}\n");
+    } else {
+        std::printf("metric,mean,min,p50,p90,p99,max\n");
+        for (const auto& row : rows)
+            std::printf("%s,%.3f,%ld,%ld,%ld,%ld,%ld\n",
+                        row.name, row.d.mean, row.d.min, row.d.p50, row.d.p90, row.d.p99, row.d.max);
+    }
+    std::fprintf(stderr, "[batch] games=%u threads=%u steals=%llu ticks=%llu elapsed_ms=%.1f games/s=%.0f ticks/s=%.0f\n",
+                 games, threads, (unsigned long long)steals.load(), (unsigned long long)total_ticks,
+                 secs * 1e3, games / secs, total_ticks / secs);
+    return 0;
+}
 
-        // bottom border
-        for (int i = 0; i < pad; ++i) cout << ' ';
-        cout << '+';
-        for (int c = 0; c < COLS; ++c) cout << '-';
-        cout << "+\n";
+// ---------- Asset pack builder (--build-pack) ----------
+// Bakes every asset file under the root into <root>.pack, the one place the game looks
+// for it (see PackHeader). Written to a temp file and renamed, so a running game never
+// maps a half-written pack.
+static int run_build_pack() {
+    struct Blob { Asset asset; PackForm form; std::string bytes; uint64_t src_size; int64_t src_mtime; };
+    const std::string out = g_assets.root + ".pack";
+    const char* out_path = out.c_str();
+    vector<Blob> blobs;
+    for (size_t i = 0; i < (size_t)Asset::Count; ++i) {
+        const Asset a = (Asset)i;
+        const std::string path = g_assets.root + "/" + ASSET_FILES[i];
+        std::string file;
+        struct stat st{};
+        if (!asset_valid(path) || ::stat(path.c_str(), &st) != 0 || !read_file(path.c_str(), file)) continue;
+        Blob b{ a, PackForm::Raw, {}, (uint64_t)st.st_size, (int64_t)st.st_mtime };
+        switch (a) {
+        case Asset::PoopWav: case Asset::NomWav: case Asset::NastyWav: case Asset::GrossWav: {
+            std::vector<int16_t> pcm;
+            if (!decode_wav(file, pcm)) {
+                std::fprintf(stderr, "[pack] skipping %s: unsupported WAV\n", path.c_str());
+                b.form = PackForm::Skipped;
+                break;
+            }
+            b.form = PackForm::Pcm;
+            b.bytes.assign((const char*)pcm.data(), pcm.size() * sizeof(int16_t));
+            break;
+        }
+        case Asset::Splash:
+            b.form = PackForm::Base64;
+            b.bytes = b64_encode(file);
+            break;
+        default:
+            b.bytes = std::move(file); // music streams straight from the original WAV
+            break;
+        }
+        blobs.push_back(std::move(b));
+    }
 
-        center_line("W/A/S/D to move, Q to quit.");
-        if (game_over) center_line("Game Over. Press Q to exit.");
-        if (level_flash > 0) center_line("\x1b[1m\x1b[93mLEVEL UP!  Speed increased\x1b[0m");
+    PackHeader h{};
+    std::memcpy(h.magic, PACK_MAGIC, 8);
+    h.version = PACK_VERSION;
+    h.count = (uint32_t)blobs.size();
+    h.audio_rate = AUDIO_RATE;
+    vector<PackEntry> table(blobs.size());
+    auto align = [](uint64_t x) { return (x + 63) & ~(uint64_t)63; };
+    uint64_t off = align(sizeof h + table.size() * sizeof(PackEntry));
+    for (size_t i = 0; i < blobs.size(); ++i) {
+        table[i] = PackEntry{};
+        table[i].asset = (uint8_t)blobs[i].asset;
+        table[i].form = (uint8_t)blobs[i].form;
+        table[i].offset = off;
+        table[i].size = blobs[i].bytes.size();
+        table[i].src_size = blobs[i].src_size;
+        table[i].src_mtime = blobs[i].src_mtime;
+        off = align(off + blobs[i].bytes.size());
+    }
 
-        cout.flush();
+    const std::string tmp = std::string(out_path) + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        std::fprintf(stderr, "[pack] cannot write %s\n", tmp.c_str());
+        return 1;
     }
-};
+    static const char zeros[64] = {};
+    uint64_t pos = 0;
+    auto put = [&](const void* p, size_t n) { std::fwrite(p, 1, n, f); pos += n; };
+    put(&h, sizeof h);
+    put(table.data(), table.size() * sizeof(PackEntry));
+    for (size_t i = 0; i < blobs.size(); ++i) {
+        put(zeros, (size_t)(table[i].offset - pos));
+        put(blobs[i].bytes.data(), blobs[i].bytes.size());
+    }
+    const bool ok = std::fflush(f) == 0 && !std::ferror(f);
+    std::fclose(f);
+    if (!ok || std::rename(tmp.c_str(), out_path) != 0) {
+        std::fprintf(stderr, "[pack] failed writing %s\n", out_path);
+        std::remove(tmp.c_str());
+        return 1;
+    }
+    std::fprintf(stderr, "[pack] wrote %s: %zu assets, %llu bytes\n", out_path, blobs.size(), (unsigned long long)pos);
+    return 0;
+}
+
+// ---------- Allocation check (--alloc-check) ----------
+// Plays policy games through tick + render + present (nothing is written) and fails
+// if any of that allocates once warmed up. Starting a fresh game after a death is
+// setup, not steady state, and is left out of the count.
+static int run_alloc_check(uint32_t seed, uint64_t ticks) {
+    constexpr uint64_t WARMUP = 1000;
+    Screen scr;
+    FrameBuf out;
+    uint32_t games = 0;
+    Game g(seed);
+    g.refresh_idle_threshold();
+    mt19937 policy_rng(seed ^ 0x9E3779B9u);
+
+    uint64_t counted = 0;
+    for (uint64_t t = 0; t < WARMUP + ticks; ++t) {
+        if (g.game_over) {
+            g = Game(seed + ++games);
+            g.refresh_idle_threshold();
+        }
+        const uint64_t before = g_allocs.load(std::memory_order_relaxed);
+        policy_step(g, policy_rng);
+        g.update();
+        g.render(scr, t * BASE_TICK_MS);
+        present(scr, out);
+        if (t >= WARMUP) counted += g_allocs.load(std::memory_order_relaxed) - before;
+    }
+    std::printf("[alloc-check] ticks=%llu games=%u allocations=%llu\n",
+                (unsigned long long)ticks, games + 1, (unsigned long long)counted);
+    return counted == 0 ? 0 : 1;
+}
 
-int main() {
+int main(int argc, char** argv) {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
 
+    uint32_t seed = std::random_device{}();
+    bool headless = false;
+    const char* script_path = nullptr;
+    uint64_t sim_ticks = 1000000;
+    uint32_t batch_games = 0;
+    unsigned batch_threads = 0;
+    bool batch_json = false;
+    bool alloc_check = false;
+    const char* audio_spec = "auto";
+    const char* assets_root = nullptr;
+    bool build_pack = false;
+    bool bench_render = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--bench-render") == 0) bench_render = true;
+        if (std::strcmp(argv[i], "--stats") == 0) g_timing.enabled = true;
+        if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        if (std::strcmp(argv[i], "--headless") == 0) headless = true;
+        if (std::strcmp(argv[i], "--script") == 0 && i + 1 < argc) script_path = argv[++i];
+        if (std::strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) sim_ticks = std::strtoull(argv[++i], nullptr, 10);
+        if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc) batch_games = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) batch_threads = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+        if (std::strcmp(argv[i], "--json") == 0) batch_json = true;
+        if (std::strcmp(argv[i], "--alloc-check") == 0) alloc_check = true;
+        if (std::strcmp(argv[i], "--audio") == 0 && i + 1 < argc) audio_spec = argv[++i];
+        if (std::strcmp(argv[i], "--assets") == 0 && i + 1 < argc) assets_root = argv[++i];
+        if (std::strcmp(argv[i], "--build-pack") == 0) build_pack = true;
+    }
+    resolve_assets(argc > 0 ? argv[0] : nullptr, assets_root);
+    if (build_pack) return run_build_pack();
+    if (bench_render) return run_render_bench();
+    if (alloc_check) return run_alloc_check(seed, 100000);
+    if (batch_games) return run_batch(seed, batch_games, batch_threads, sim_ticks, batch_json);
+    if (headless) return run_headless(seed, sim_ticks, script_path);
+
+    // Decode every clip and start the mixer before the terminal goes raw. With nothing
+    // to play through there is no mixer thread at all, and queue_sfx() is a no-op.
+    AudioEngine audio;
+    if (ENABLE_SOUNDS) {
+        if (!open_audio_sink(audio.sink, audio_spec))
+            std::cerr << "[audio] cannot open sink '" << audio_spec << "', staying silent\n";
+        if (audio.sink.kind != SinkKind::Null) {
+            load_sound_bank(audio);
+            audio.start();
+            g_audio = &audio;
+        }
+    }
+
     RawTerm raw;
+    detect_term_caps(raw.ok);
+    EventLoop loop;
 
     // Splash (title theme starts/stops internally)
-    cinematic_splash_and_wait();
+    cinematic_splash_and_wait(loop);
 
     // Start quiet background loop for gameplay
     start_bg_music();
 
-    Game game;
+    Game game(seed);
     game.refresh_idle_threshold();
 
-    int tick_ms = BASE_TICK_MS;
-    auto current_tick = chrono::milliseconds(tick_ms);
+    Screen screen;
+    FrameBuf frame_out;
+    cout << "\x1b[?25l" << flush; // frames bypass cout from here on
+
     auto next_tick = chrono::steady_clock::now();
+    auto next_frame = next_tick;
+    bool dirty = true;   // something changed since the last frame
+    bool paused = false; // set by stall detection, cleared by any key
 
+    InputDecoder decoder;
+    loop.arm(next_tick);
     while (running.load()) {
-        // pump raw keys
-        bool steered_this_frame = false;
-        while (true) {
-            auto k = read_key_now();
-            if (!k) break;
-            if (*k == 3) { running.store(false); break; } // Ctrl-C
-            enqueue(*k);
-        }
-
-        if (auto key = poll_key()) {
-            if (*key == 'Q') { running.store(false); break; }
-            else {
-                game.change_dir(*key);
-                steered_this_frame = true;
+        unsigned ev = loop.wait();
+        if (ev & EV_QUIT) { running.store(false); break; }
+
+        // pump raw keys (all that arrived; stdin EOF stops watching it)
+        if (ev & EV_INPUT) {
+            unsigned char buf[512];
+            ssize_t n = read_input(buf, sizeof buf);
+            if (n <= 0) {
+                loop.watch_input = false;
+            } else {
+                auto t_read = chrono::steady_clock::now();
+                decoder.feed(buf, (size_t)n, [&](Key k) {
+                    if (!enqueue(k, t_read)) running.store(false); // Q / Ctrl-C
+                });
+                if (paused) {
+                    // the key that resumes doesn't also steer
+                    KeyEvent e;
+                    while (in_ring.pop(e)) {}
+                    paused = false;
+                    dirty = true;
+                    next_tick = t_read + chrono::milliseconds(game.tick_ms);
+                }
             }
+            if (!running.load()) break;
         }
-        if (steered_this_frame) game.on_player_input();
+
+        if (ev & EV_RESIZE) dirty = true;
 
         auto now = chrono::steady_clock::now();
-        if (now >= next_tick) {
-            while (now >= next_tick) {
-                game.speed_bump_trigger = false;
-                game.speed_bump_amount  = 0;
-
-                game.update();
-
-                // Priority: reward slow-down overrides bumps this tick
-                if (game.slow_down_trigger) {
-                    game.slow_down_trigger = false;
-                    tick_ms = BASE_TICK_MS;
-                    current_tick = chrono::milliseconds(tick_ms);
-                    game.speed_bump_trigger = false;
-                    game.speed_bump_amount  = 0;
-                } else {
-                    if (game.level_up_trigger) {
-                        game.level_up_trigger = false;
-                        tick_ms = std::max(MIN_TICK_MS, tick_ms - TICK_DECR_MS);
-                        current_tick = chrono::milliseconds(tick_ms);
-                    }
-                    if (game.speed_bump_trigger && game.speed_bump_amount > 0) {
-                        int total = GROW_DECR_MS * game.speed_bump_amount;
-                        tick_ms = std::max(MIN_TICK_MS, tick_ms - total);
-                        current_tick = chrono::milliseconds(tick_ms);
-                    }
+        if (!paused && now >= next_tick) {
+            if (now - next_tick > chrono::milliseconds(STALL_MS) && loop.watch_input) {
+                // Woke far too late (suspended, blocked on the terminal, ...):
+                // replaying the gap would teleport the snake, so stop and wait for the player.
+                paused = true;
+                g_loop_stats.stalls++;
+            } else {
+                for (int n = 0; n < MAX_CATCHUP_TICKS && now >= next_tick; ++n) {
+                    consume_input(game, next_tick);
+                    timed_update(game);
+                    next_tick += chrono::milliseconds(game.tick_ms);
                 }
-
-                next_tick += current_tick;
+                if (now >= next_tick) {
+                    // Over budget: let the schedule slip rather than run even more ticks back to back.
+                    g_loop_stats.ticks_skipped += (uint64_t)((now - next_tick) / chrono::milliseconds(game.tick_ms)) + 1;
+                    next_tick = now + chrono::milliseconds(game.tick_ms);
+                }
+                g_timing.tick_ms = game.tick_ms;
             }
+            dirty = true;
+        }
 
-            // 🔊 Play exactly one queued sound for this frame
-            flush_sound();
-
-            game.render();
-        } else {
-            this_thread::sleep_until(next_tick);
+        if (dirty && now >= next_frame) {
+            draw_frame(game, screen, frame_out, paused);
+            dirty = false;
+            next_frame = now + chrono::milliseconds(FRAME_MS);
         }
+
+        // Sleep until the next tick, or the frame slot of a pending redraw if that's sooner.
+        if (dirty && (paused || next_frame < next_tick)) loop.arm(next_frame);
+        else if (!paused)                                loop.arm(next_tick);
+        else                                             loop.disarm();
     }
 
     // Cleanup audio before exiting
     stop_bg_music();
     stop_title_music();
+    g_audio = nullptr;
+    audio.shutdown();
 
-    cout << RESET << "\x1b[2J\x1b[H";
+    cout << RESET << "\x1b[2J\x1b[H\x1b[?25h";
     cout << "Thanks for playing.\n";
+    cout.flush();
+    std::cerr << "[game] seed=" << game.seed << " score=" << game.score << " level=" << game.level << "\n";
+    dump_caps();
+    dump_render_stats();
+    dump_loop_stats();
+    dump_timing_stats();
+    if (ENABLE_SOUNDS) dump_audio_stats(audio);
     return 0;
 }